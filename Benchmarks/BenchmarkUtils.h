@@ -0,0 +1,80 @@
+#ifndef QT_UTILS_BENCHMARK_UTILS_H
+#define QT_UTILS_BENCHMARK_UTILS_H
+
+//!
+//! Helpers shared by the benchmarks, so that they all measure and report their results the
+//! same way, and that their numbers can be compared.
+//!
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QTextStream>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+
+//!
+//! Get the given percentile (0 to 1) of a list of samples: the sample at index
+//! `percentile * count` once sorted (nearest rank).
+//!
+inline double Percentile(std::vector< double > samples, double percentile)
+{
+	if (samples.empty() == true)
+	{
+		return 0.0;
+	}
+	std::sort(samples.begin(), samples.end());
+	const size_t index = std::min(samples.size() - 1, static_cast< size_t >(percentile * samples.size()));
+	return samples[index];
+}
+
+//!
+//! Run @p function @p iterations times and return the median duration in milliseconds.
+//! The function returns a value that depends on the result, which is added to @p checksum
+//! so that the measured work can't be optimized away.
+//!
+inline double Measure(int iterations, quint64 & checksum, const std::function< quint64 (void) > & function)
+{
+	std::vector< double > durations;
+	for (int i = 0; i < iterations; ++i)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		checksum += function();
+		durations.push_back(timer.nsecsElapsed() / 1e6);
+	}
+	return Percentile(durations, 0.5);
+}
+
+//!
+//! Write the results of a benchmark as JSON to @p filename, or to the standard output if
+//! it's empty.
+//!
+//! @returns
+//!		false if the file couldn't be written.
+//!
+inline bool WriteResults(const QJsonObject & results, const QString & filename)
+{
+	const QByteArray json = QJsonDocument(results).toJson();
+	if (filename.isEmpty() == true)
+	{
+		QTextStream(stdout) << json;
+		return true;
+	}
+
+	QFile file(filename);
+	if (file.open(QIODevice::WriteOnly) == false || file.write(json) != json.size())
+	{
+		qCritical("Couldn't write %s", qPrintable(filename));
+		return false;
+	}
+	return true;
+}
+
+
+#endif
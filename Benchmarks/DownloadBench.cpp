@@ -0,0 +1,179 @@
+//!
+//! Sustained throughput benchmark of DownloadManager, using a local range capable HTTP
+//! server. A file is downloaded with a single stream, with parallel segments, with a
+//! bandwidth cap, and interrupted then resumed. Each downloaded file is checked, and the
+//! throughputs are written as JSON, either on the standard output or in the file given
+//! with `--output`.
+//!
+//! Usage: QtUtils_DownloadBench [--size BYTES] [--segments N] [--bandwidth BYTES_PER_SECOND] [--output results.json]
+//!
+
+#include "./BenchmarkUtils.h"
+#include "./LocalHttpServer.h"
+#include "../DownloadManager.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSemaphore>
+#include <QTemporaryDir>
+
+#include <atomic>
+
+
+#if defined(QT_UTILS_NAMESPACE)
+using namespace QT_UTILS_NAMESPACE;
+#endif
+
+//!
+//! Check that @p filename contains the body served by LocalHttpServer.
+//!
+static bool Check(const QString & filename, qint64 size)
+{
+	QFile file(filename);
+	if (file.open(QIODevice::ReadOnly) == false || file.size() != size)
+	{
+		return false;
+	}
+	qint64 offset = 0;
+	while (file.atEnd() == false)
+	{
+		const QByteArray data = file.read(1024 * 1024);
+		for (int i = 0; i < data.size(); ++i)
+		{
+			if (data[i] != static_cast< char >('a' + (offset + i) % 26))
+			{
+				return false;
+			}
+		}
+		offset += data.size();
+	}
+	return true;
+}
+
+//!
+//! Download @p url into @p filename and wait for the result. If @p stopAt is positive,
+//! the download is stopped once that many bytes were received.
+//!
+static bool Download(const QString & url, const QString & filename, const DownloadManager::Options & baseOptions, qint64 stopAt = -1)
+{
+	QSemaphore done;
+	std::atomic< bool > succeeded{ false };
+	std::atomic< int > id{ -1 };
+	std::atomic< bool > stopped{ false };
+
+	DownloadManager::Options options = baseOptions;
+	if (stopAt > 0)
+	{
+		// the first progress reports can come before the id is known: stop on a later one
+		options.progress = [&] (qint64 received, qint64) {
+			if (received >= stopAt && id != -1 && stopped.exchange(true) == false)
+			{
+				DownloadManager::Stop(id);
+			}
+		};
+	}
+
+	id = DownloadManager::Download(url, filename,
+		[&] (qint64) { succeeded = true; done.release(); },
+		[&] (QNetworkReply::NetworkError, QString) { done.release(); },
+		options
+	);
+	done.acquire();
+	return succeeded;
+}
+
+//!
+//! Build the JSON result of a run.
+//!
+static QJsonObject ToJson(const QString & name, qint64 size, double seconds, bool valid)
+{
+	return {
+		{ "name",				name },
+		{ "seconds",			seconds },
+		{ "megabytesPerSecond",	size / seconds / (1024.0 * 1024.0) },
+		{ "valid",				valid },
+	};
+}
+
+//!
+//! Entry point.
+//!
+int main(int argc, char ** argv)
+{
+	QCoreApplication application(argc, argv);
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption({ "size", "Size of the downloaded file, in bytes.", "bytes", "67108864" });
+	parser.addOption({ "segments", "Number of segments of the segmented download.", "count", "4" });
+	parser.addOption({ "bandwidth", "Bandwidth cap of the throttled download, in bytes per second.", "bytes", "16777216" });
+	parser.addOption({ "output", "Output JSON file (standard output if not set)", "file" });
+	parser.process(application);
+
+	const qint64 size		= qMax(qint64(1), parser.value("size").toLongLong());
+	const int segments		= qMax(1, parser.value("segments").toInt());
+	const qint64 bandwidth	= qMax(qint64(1), parser.value("bandwidth").toLongLong());
+
+	LocalHttpServer server;
+	QTemporaryDir directory;
+	if (server.Start() == false || directory.isValid() == false)
+	{
+		qCritical("Couldn't start the local server");
+		return 1;
+	}
+	const QString url = server.GetUrl(QString("/file?size=%1").arg(size));
+
+	QJsonArray results;
+	auto run = [&] (const QString & name, const DownloadManager::Options & options, qint64 stopAt) {
+		const QString filename = directory.filePath(name);
+		QElapsedTimer timer;
+		timer.start();
+		if (stopAt > 0)
+		{
+			Download(url, filename, options, stopAt);
+		}
+		const bool succeeded = Download(url, filename, options);
+		const double seconds = timer.nsecsElapsed() / 1e9;
+		results.append(ToJson(name, size, seconds, succeeded == true && Check(filename, size) == true));
+		QFile::remove(filename);
+	};
+
+	// single stream
+	run("single", DownloadManager::Options(), -1);
+
+	// parallel segments
+	{
+		DownloadManager::Options options;
+		options.segments = segments;
+		options.minSegmentSize = 1;
+		run("segmented", options, -1);
+	}
+
+	// bandwidth cap
+	{
+		DownloadManager::Options options;
+		options.bandwidth = bandwidth;
+		run("throttled", options, -1);
+	}
+
+	// stopped at half, then resumed
+	run("resumed", DownloadManager::Options(), size / 2);
+
+	const QJsonObject output{
+		{ "benchmark",	"QtUtils_DownloadBench" },
+		{ "size",		static_cast< double >(size) },
+		{ "segments",	segments },
+		{ "bandwidth",	static_cast< double >(bandwidth) },
+		{ "results",	results },
+	};
+	if (WriteResults(output, parser.value("output")) == false)
+	{
+		return 1;
+	}
+
+	return 0;
+}
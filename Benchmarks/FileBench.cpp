@@ -0,0 +1,156 @@
+//!
+//! Benchmark of the mapped reads of the File module against reading files with
+//! QFile::readAll, on files from 1MB to 1GB (by default).
+//!
+//! For each file size, the following paths are measured:
+//!
+//! - `readAll`			: QFile::readAll, bytes only
+//! - `readAllString`	: QFile::readAll then conversion to QString (the previous File::read)
+//! - `mapped`			: MappedFile view, touching every page so that the data is really read
+//! - `mappedString`	: File::read, which decodes the string directly from the mapping
+//!
+//! Strings can't hold more than 1G characters with Qt 5, so the string paths are skipped
+//! for files bigger than 512MB. The files are freshly written, so they are read from the
+//! page cache: this measures the copies and conversions, not the disk.
+//!
+//! Usage: QtUtils_FileBench [--sizes MB,MB,...] [--iterations N] [--output results.json]
+//!
+
+#include "./BenchmarkUtils.h"
+#include "../File.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+
+#if defined(QT_UTILS_NAMESPACE)
+using namespace QT_UTILS_NAMESPACE;
+#endif
+
+//! Biggest file for which the string paths are measured
+static constexpr qint64 s_MaxStringSize = 512 * 1024 * 1024;
+
+//!
+//! Write a text file of @p size bytes.
+//!
+static bool CreateFile(const QString & filename, qint64 size)
+{
+	QByteArray block;
+	while (block.size() < 1024 * 1024)
+	{
+		block += "The quick brown fox jumps over the lazy dog. 0123456789\n";
+	}
+
+	QFile file(filename);
+	if (file.open(QIODevice::WriteOnly) == false)
+	{
+		return false;
+	}
+	for (qint64 written = 0; written < size;)
+	{
+		const qint64 count = qMin(qint64(block.size()), size - written);
+		if (file.write(block.constData(), count) != count)
+		{
+			return false;
+		}
+		written += count;
+	}
+	return true;
+}
+
+//!
+//! Entry point.
+//!
+int main(int argc, char ** argv)
+{
+	QCoreApplication application(argc, argv);
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption({ "sizes", "Comma separated file sizes, in MB.", "sizes", "1,16,256,1024" });
+	parser.addOption({ "iterations", "Number of iterations of each measure (the median is kept)", "count", "3" });
+	parser.addOption({ "output", "Output JSON file (standard output if not set)", "file" });
+	parser.process(application);
+
+	const int iterations = qMax(1, parser.value("iterations").toInt());
+
+	QTemporaryDir directory;
+	if (directory.isValid() == false)
+	{
+		qCritical("Couldn't create a temporary directory");
+		return 1;
+	}
+
+	QJsonArray results;
+	quint64 checksum = 0;
+	for (const QString & value : parser.value("sizes").split(','))
+	{
+		const qint64 size = value.toLongLong() * 1024 * 1024;
+		const QString filename = directory.filePath("file.txt");
+		if (size <= 0 || CreateFile(filename, size) == false)
+		{
+			qCritical("Couldn't create a %s MB file", qPrintable(value));
+			return 1;
+		}
+
+		QJsonObject result{ { "sizeMB", value.toInt() } };
+		auto add = [&] (const QString & name, double ms) {
+			result.insert(name + "Ms", ms);
+			result.insert(name + "MBps", size / (1024.0 * 1024.0) / (ms / 1000.0));
+		};
+
+		add("readAll", Measure(iterations, checksum, [&] (void) {
+			QFile file(filename);
+			file.open(QIODevice::ReadOnly);
+			return static_cast< quint64 >(file.readAll().size());
+		}));
+
+		add("mapped", Measure(iterations, checksum, [&] (void) {
+			const MappedFile file(filename);
+			quint64 sum = 0;
+			for (qint64 i = 0; i < file.GetSize(); i += 4096)
+			{
+				sum += static_cast< unsigned char >(file.GetData()[i]);
+			}
+			return sum;
+		}));
+
+		if (size <= s_MaxStringSize)
+		{
+			add("readAllString", Measure(iterations, checksum, [&] (void) {
+				QFile file(filename);
+				file.open(QIODevice::ReadOnly);
+				return static_cast< quint64 >(QString(file.readAll()).size());
+			}));
+
+			add("mappedString", Measure(iterations, checksum, [&] (void) {
+				return static_cast< quint64 >(File().read(filename).size());
+			}));
+		}
+
+		results.append(result);
+		QFile::remove(filename);
+	}
+
+	const QJsonObject output{
+		{ "benchmark",	"QtUtils_FileBench" },
+		{ "iterations",	iterations },
+		{ "checksum",	QString::number(checksum) },
+		{ "results",	results },
+	};
+	if (WriteResults(output, parser.value("output")) == false)
+	{
+		return 1;
+	}
+
+	return 0;
+}
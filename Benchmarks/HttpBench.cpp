@@ -0,0 +1,456 @@
+//!
+//! Benchmark of the HttpRequest helpers, using a local HTTP server so that it doesn't
+//! depend on the internet. The synchronous, asynchronous and streaming paths are measured
+//! against the same replies, whose size, latency, transfer encoding and number of
+//! redirections are configurable.
+//!
+//! For each path, the throughput, the latency percentiles (as seen by the caller, and the
+//! time to first byte reported by the timing callback) and the peak memory are written as
+//! JSON, either on the standard output or in the file given with `--output`.
+//!
+//! The resilience options of RequestOptions are measured against injected delays and
+//! failures, with `--probes` requests sent one at a time:
+//!
+//! - `hedge`	: the first attempt of each request stalls for 1 second, and the hedged one wins
+//! - `timeout`	: the replies take 250ms, and the requests time out after 50ms
+//! - `retries`	: the first 2 attempts of each request fail with a 503, and are retried
+//!
+//! Those run first, so that the hedging delay isn't based on the latencies of the loaded
+//! runs. Whether each of them behaved as expected is also reported in `checks`.
+//!
+//! A few behaviors which can't be seen in the timings are also checked against the local
+//! server, and reported in `checks`. The exit code is 2 if one of them fails:
+//!
+//! - `redirectN`	: permanent redirections (301, 308) are cached, so that the second request
+//!				  to the same url skips the hop, while temporary ones (302) are not
+//! - `cacheFresh`	: with HttpCache enabled, fresh replies (`max-age=60`) are served from the
+//!				  cache without reaching the server
+//! - `cacheStale`	: stale replies (`max-age=0`) are revalidated, and the 304 replies are served
+//!				  from the cache
+//!
+//! Usage: QtUtils_HttpBench [--requests N] [--concurrency N] [--size BYTES] [--delay MS] [--chunk BYTES] [--redirects N] [--probes N] [--output results.json]
+//!
+
+#include "./BenchmarkUtils.h"
+#include "./LocalHttpServer.h"
+#include "../HttpCache.h"
+#include "../HttpRequest.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#if defined(Q_OS_WIN)
+#	include <windows.h>
+#	include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#	include <sys/resource.h>
+#endif
+
+
+#if defined(QT_UTILS_NAMESPACE)
+using namespace QT_UTILS_NAMESPACE;
+#endif
+
+//!
+//! Reset the peak memory of the process, when the platform allows it (Linux only)
+//!
+static void ResetPeakMemory(void)
+{
+#if defined(Q_OS_LINUX)
+	QFile file("/proc/self/clear_refs");
+	if (file.open(QIODevice::WriteOnly) == true)
+	{
+		file.write("5");
+	}
+#endif
+}
+
+//!
+//! Get the peak memory (resident set size) of the process, in bytes.
+//!
+static qint64 GetPeakMemory(void)
+{
+#if defined(Q_OS_LINUX)
+	QFile file("/proc/self/status");
+	if (file.open(QIODevice::ReadOnly) == true)
+	{
+		for (const QByteArray & line : file.readAll().split('\n'))
+		{
+			if (line.startsWith("VmHWM:") == true)
+			{
+				return line.mid(6).trimmed().split(' ').value(0).toLongLong() * 1024;
+			}
+		}
+	}
+	return 0;
+#elif defined(Q_OS_WIN)
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? static_cast< qint64 >(counters.PeakWorkingSetSize) : 0;
+#elif defined(Q_OS_MACOS)
+	rusage usage;
+	return getrusage(RUSAGE_SELF, &usage) == 0 ? static_cast< qint64 >(usage.ru_maxrss) : 0;
+#else
+	rusage usage;
+	return getrusage(RUSAGE_SELF, &usage) == 0 ? static_cast< qint64 >(usage.ru_maxrss) * 1024 : 0;
+#endif
+}
+
+//!
+//! Samples of a run.
+//!
+struct Samples
+{
+	QMutex mutex;
+	std::vector< double > latencies;
+	std::vector< double > firstBytes;
+	std::atomic< int > failed{ 0 };
+};
+
+//!
+//! Build the JSON result of a run.
+//!
+static QJsonObject ToJson(const QString & path, int requests, double seconds, Samples & samples)
+{
+	QMutexLocker lock(&samples.mutex);
+	return {
+		{ "path",				path },
+		{ "requests",			requests },
+		{ "failed",				samples.failed.load() },
+		{ "seconds",			seconds },
+		{ "requestsPerSecond",	requests / seconds },
+		{ "p50Ms",				Percentile(samples.latencies, 0.5) },
+		{ "p90Ms",				Percentile(samples.latencies, 0.9) },
+		{ "p99Ms",				Percentile(samples.latencies, 0.99) },
+		{ "firstByteP50Ms",		Percentile(samples.firstBytes, 0.5) },
+		{ "firstByteP99Ms",		Percentile(samples.firstBytes, 0.99) },
+		{ "peakMemoryBytes",	static_cast< double >(GetPeakMemory()) },
+	};
+}
+
+//!
+//! Request a url redirected with @p status twice, and check that the second request only
+//! skipped the hop if the redirection is permanent.
+//!
+static QJsonObject CheckRedirection(LocalHttpServer & server, int status)
+{
+	ClearRedirectionCache();
+	server.ResetRequestCounts();
+	const QString url = server.GetUrl(QString("/redirect?status=%1&size=1024").arg(status));
+	const bool replied = RequestUrl(url).size() == 1024 && RequestUrl(url).size() == 1024;
+	const bool permanent = status == 301 || status == 308;
+	const int redirects = server.GetRequestCount("/redirect");
+	const int payloads = server.GetRequestCount("/payload");
+	return {
+		{ "name",				QString("redirect%1").arg(status) },
+		{ "ok",					replied == true && redirects == (permanent == true ? 1 : 2) && payloads == 2 },
+		{ "redirectRequests",	redirects },
+		{ "payloadRequests",	payloads },
+	};
+}
+
+//!
+//! Request the same url 3 times with HttpCache enabled, the reply being fresh for @p maxAge
+//! seconds, and check that the last 2 requests were served from the cache: directly if the
+//! reply is fresh, or after a revalidation if it's stale.
+//!
+static QJsonObject CheckCache(LocalHttpServer & server, const QString & directory, int maxAge)
+{
+	HttpCache::SetEnabled(true);
+	HttpCache::SetDirectory(directory);
+	HttpCache::Clear();
+	HttpCache::ResetStats();
+	server.ResetRequestCounts();
+	const QString url = server.GetUrl(QString("/payload?size=1024&maxage=%1").arg(maxAge));
+	bool replied = true;
+	for (int i = 0; i < 3; ++i)
+	{
+		replied = replied && RequestUrl(url).size() == 1024;
+	}
+	const HttpCache::Stats stats = HttpCache::GetStats();
+	const int payloads = server.GetRequestCount("/payload");
+	HttpCache::SetEnabled(false);
+
+	const bool fresh = maxAge > 0;
+	const bool ok = replied == true
+		&& stats.misses == 1
+		&& stats.hits == (fresh == true ? 2 : 0)
+		&& stats.revalidations == (fresh == true ? 0 : 2)
+		&& payloads == (fresh == true ? 1 : 3);
+	return {
+		{ "name",				fresh == true ? "cacheFresh" : "cacheStale" },
+		{ "ok",					ok },
+		{ "hits",				static_cast< double >(stats.hits) },
+		{ "revalidations",		static_cast< double >(stats.revalidations) },
+		{ "misses",				static_cast< double >(stats.misses) },
+		{ "payloadRequests",	payloads },
+	};
+}
+
+//!
+//! Entry point.
+//!
+int main(int argc, char ** argv)
+{
+	QCoreApplication application(argc, argv);
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption({ "requests", "Number of requests per path.", "count", "2000" });
+	parser.addOption({ "concurrency", "Number of threads sending synchronous requests.", "count", "8" });
+	parser.addOption({ "size", "Size of each reply, in bytes.", "bytes", "65536" });
+	parser.addOption({ "delay", "Server side delay of each reply, in milliseconds.", "ms", "0" });
+	parser.addOption({ "chunk", "If set, replies use the chunked transfer encoding with chunks of this size.", "bytes", "0" });
+	parser.addOption({ "redirects", "Number of redirections before each reply.", "count", "0" });
+	parser.addOption({ "probes", "Number of requests of the hedge, timeout and retries runs.", "count", "20" });
+	parser.addOption({ "output", "Output JSON file (standard output if not set)", "file" });
+	parser.process(application);
+
+	const int requests		= qMax(1, parser.value("requests").toInt());
+	const int concurrency	= qMax(1, parser.value("concurrency").toInt());
+	const int size			= qMax(0, parser.value("size").toInt());
+	const int delay			= qMax(0, parser.value("delay").toInt());
+	const int chunk			= qMax(0, parser.value("chunk").toInt());
+	const int redirects		= qMax(0, parser.value("redirects").toInt());
+	const int probes		= qMax(1, parser.value("probes").toInt());
+
+	LocalHttpServer server;
+	if (server.Start() == false)
+	{
+		qCritical("Couldn't start the local server");
+		return 1;
+	}
+
+	// each url is unique so that requests are not coalesced
+	auto getUrl = [&] (const QString & path, int id) {
+		return server.GetUrl(QString("/%1?size=%2&delay=%3&chunk=%4&redirect=%5&id=%6")
+			.arg(path).arg(size).arg(delay).arg(chunk).arg(redirects).arg(id));
+	};
+
+	// the time to first byte comes from the timing callback
+	Samples * current = nullptr;
+	QMutex currentMutex;
+	SetTimingCallback([&] (const RequestTiming & timing) {
+		QMutexLocker lock(&currentMutex);
+		if (current != nullptr && timing.firstByte >= 0)
+		{
+			QMutexLocker samplesLock(&current->mutex);
+			current->firstBytes.push_back(timing.firstByte / 1000.0);
+		}
+	});
+	auto setCurrent = [&] (Samples * samples) {
+		QMutexLocker lock(&currentMutex);
+		current = samples;
+	};
+
+	QJsonArray results;
+	QJsonArray checks;
+
+	// requests with resilience options, sent one at a time against injected delays and failures
+	auto probe = [&] (const QString & path, const QString & query, const RequestOptions & options) {
+		Samples samples;
+		setCurrent(&samples);
+		ResetPeakMemory();
+		server.ResetRequestCounts();
+		std::atomic< int > timedOut{ 0 };
+		QSemaphore done;
+		QElapsedTimer timer;
+		timer.start();
+		for (int id = 0; id < probes; ++id)
+		{
+			const qint64 start = timer.nsecsElapsed();
+			auto record = [&, start] (bool success) {
+				const double ms = (timer.nsecsElapsed() - start) / 1e6;
+				samples.failed += success ? 0 : 1;
+				{
+					QMutexLocker lock(&samples.mutex);
+					samples.latencies.push_back(ms);
+				}
+				done.release();
+			};
+			RequestUrl(
+				server.GetUrl(QString("/%1?size=%2&id=%3&%4").arg(path).arg(size).arg(id).arg(query)),
+				[record, size] (QByteArray reply) { record(reply.size() == size); },
+				[record, &timedOut] (QNetworkReply::NetworkError error, QString) {
+					timedOut += error == QNetworkReply::TimeoutError ? 1 : 0;
+					record(false);
+				},
+				options
+			);
+			done.acquire();
+		}
+		QJsonObject result = ToJson(path, probes, timer.nsecsElapsed() / 1e9, samples);
+		result.insert("timedOut", timedOut.load());
+		result.insert("serverRequests", server.GetRequestCount("/" + path));
+		results.append(result);
+		setCurrent(nullptr);
+		return result;
+	};
+	{
+		RequestOptions options;
+		options.hedge = true;
+		const QJsonObject result = probe("hedge", "stall=1000", options);
+		checks.append(QJsonObject{
+			{ "name",	"hedge" },
+			{ "ok",		result.value("failed").toInt() == 0 && result.value("p99Ms").toDouble() < 1000.0 },
+		});
+	}
+	{
+		RequestOptions options;
+		options.timeout = 50;
+		const QJsonObject result = probe("timeout", "delay=250", options);
+		checks.append(QJsonObject{
+			{ "name",	"timeout" },
+			{ "ok",		result.value("timedOut").toInt() == probes && result.value("p99Ms").toDouble() < 250.0 },
+		});
+	}
+	{
+		RequestOptions options;
+		options.retries = 2;
+		options.retryDelay = 10;
+		const QJsonObject result = probe("retries", "fail=2", options);
+		checks.append(QJsonObject{
+			{ "name",	"retries" },
+			{ "ok",		result.value("failed").toInt() == 0 && result.value("serverRequests").toInt() == 3 * probes },
+		});
+	}
+
+	// synchronous requests, sent from a few threads
+	{
+		Samples samples;
+		setCurrent(&samples);
+		ResetPeakMemory();
+		std::atomic< int > next{ 0 };
+		QElapsedTimer timer;
+		timer.start();
+		std::vector< std::thread > threads;
+		for (int i = 0; i < concurrency; ++i)
+		{
+			threads.emplace_back([&] (void) {
+				for (int id = next++; id < requests; id = next++)
+				{
+					QElapsedTimer latency;
+					latency.start();
+					const QByteArray reply = RequestUrl(getUrl("sync", id));
+					const double ms = latency.nsecsElapsed() / 1e6;
+					samples.failed += reply.size() == size ? 0 : 1;
+					QMutexLocker lock(&samples.mutex);
+					samples.latencies.push_back(ms);
+				}
+			});
+		}
+		for (std::thread & thread : threads)
+		{
+			thread.join();
+		}
+		results.append(ToJson("sync", requests, timer.nsecsElapsed() / 1e9, samples));
+		setCurrent(nullptr);
+	}
+
+	// asynchronous requests, all sent at once
+	{
+		Samples samples;
+		setCurrent(&samples);
+		ResetPeakMemory();
+		QSemaphore done;
+		QElapsedTimer timer;
+		timer.start();
+		for (int id = 0; id < requests; ++id)
+		{
+			const qint64 start = timer.nsecsElapsed();
+			auto record = [&, start] (bool success) {
+				const double ms = (timer.nsecsElapsed() - start) / 1e6;
+				samples.failed += success ? 0 : 1;
+				{
+					QMutexLocker lock(&samples.mutex);
+					samples.latencies.push_back(ms);
+				}
+				done.release();
+			};
+			RequestUrl(getUrl("async", id), [record, size] (QByteArray reply) { record(reply.size() == size); }, [record] (QNetworkReply::NetworkError, QString) { record(false); });
+		}
+		done.acquire(requests);
+		results.append(ToJson("async", requests, timer.nsecsElapsed() / 1e9, samples));
+		setCurrent(nullptr);
+	}
+
+	// streamed requests, all sent at once
+	{
+		Samples samples;
+		setCurrent(&samples);
+		ResetPeakMemory();
+		QSemaphore done;
+		QElapsedTimer timer;
+		timer.start();
+		for (int id = 0; id < requests; ++id)
+		{
+			const qint64 start = timer.nsecsElapsed();
+			auto record = [&, start] (bool success) {
+				const double ms = (timer.nsecsElapsed() - start) / 1e6;
+				samples.failed += success ? 0 : 1;
+				{
+					QMutexLocker lock(&samples.mutex);
+					samples.latencies.push_back(ms);
+				}
+				done.release();
+			};
+			StreamUrl(
+				getUrl("stream", id),
+				[] (const QByteArray &) { return true; },
+				[record, size] (qint64 received) { record(received == size); },
+				[record] (QNetworkReply::NetworkError, QString) { record(false); }
+			);
+		}
+		done.acquire(requests);
+		results.append(ToJson("stream", requests, timer.nsecsElapsed() / 1e9, samples));
+		setCurrent(nullptr);
+	}
+
+	SetTimingCallback(TimingCallback());
+
+	// behavior checks
+	for (int status : { 301, 308, 302 })
+	{
+		checks.append(CheckRedirection(server, status));
+	}
+	QTemporaryDir cacheDirectory;
+	for (int maxAge : { 60, 0 })
+	{
+		checks.append(CheckCache(server, cacheDirectory.path(), maxAge));
+	}
+	bool ok = true;
+	for (const QJsonValue & check : checks)
+	{
+		ok = ok && check.toObject().value("ok").toBool();
+	}
+
+	const QJsonObject output{
+		{ "benchmark",		"QtUtils_HttpBench" },
+		{ "size",			size },
+		{ "delay",			delay },
+		{ "chunk",			chunk },
+		{ "redirects",		redirects },
+		{ "concurrency",	concurrency },
+		{ "probes",			probes },
+		{ "results",		results },
+		{ "checks",			checks },
+	};
+	if (WriteResults(output, parser.value("output")) == false)
+	{
+		return 1;
+	}
+
+	return ok == true ? 0 : 2;
+}
@@ -0,0 +1,346 @@
+//!
+//! Benchmark of the Job executor against QtConcurrent::run and a plain std::thread pool.
+//!
+//! Each workload is run for every thread count from 1 to the maximum (by default twice the
+//! ideal thread count, to also measure oversubscription) and the results are written as a
+//! JSON document, either on the standard output or in the file given with `--output`.
+//!
+//! Usage: QtUtils_JobBench [--threads N] [--tasks N] [--output results.json]
+//!
+
+#include "./BenchmarkUtils.h"
+#include "../Job.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+#if defined(QT_UTILS_NAMESPACE)
+using namespace QT_UTILS_NAMESPACE;
+#endif
+
+//!
+//! Counts down completed tasks and let a thread wait until all of them are done. The
+//! tasks share its ownership, since the last one still uses it after waking the waiter.
+//!
+class Latch
+{
+
+public:
+
+	Latch(int count)
+		: m_Count(count)
+		, m_Done(false)
+	{
+	}
+
+	void CountDown(void)
+	{
+		if (m_Count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			std::lock_guard< std::mutex > lock(m_Mutex);
+			m_Done = true;
+			m_Condition.notify_all();
+		}
+	}
+
+	void Wait(void)
+	{
+		std::unique_lock< std::mutex > lock(m_Mutex);
+		m_Condition.wait(lock, [this] (void) { return m_Done; });
+	}
+
+private:
+
+	std::atomic< int > m_Count;
+	bool m_Done;
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+
+};
+
+//!
+//! Minimal fixed size std::thread pool, used as a baseline.
+//!
+class StdThreadPool
+{
+
+public:
+
+	StdThreadPool(int threads)
+		: m_Stop(false)
+	{
+		for (int i = 0; i < threads; ++i)
+		{
+			m_Threads.emplace_back([this] (void) {
+				for (;;)
+				{
+					std::function< void (void) > task;
+					{
+						std::unique_lock< std::mutex > lock(m_Mutex);
+						m_Condition.wait(lock, [this] (void) { return m_Stop == true || m_Tasks.empty() == false; });
+						if (m_Tasks.empty() == true)
+						{
+							return;
+						}
+						task = std::move(m_Tasks.front());
+						m_Tasks.pop_front();
+					}
+					task();
+				}
+			});
+		}
+	}
+
+	~StdThreadPool(void)
+	{
+		{
+			std::lock_guard< std::mutex > lock(m_Mutex);
+			m_Stop = true;
+		}
+		m_Condition.notify_all();
+		for (std::thread & thread : m_Threads)
+		{
+			thread.join();
+		}
+	}
+
+	void Submit(std::function< void (void) > task)
+	{
+		{
+			std::lock_guard< std::mutex > lock(m_Mutex);
+			m_Tasks.push_back(std::move(task));
+		}
+		m_Condition.notify_one();
+	}
+
+private:
+
+	bool m_Stop;
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::deque< std::function< void (void) > > m_Tasks;
+	std::vector< std::thread > m_Threads;
+
+};
+
+//!
+//! Executor abstraction : a name and a way to submit a task.
+//!
+struct Executor
+{
+	QString name;
+	std::function< void (std::function< void (void) >) > submit;
+};
+
+//!
+//! Burn some CPU for roughly @p microseconds.
+//!
+static void Spin(int microseconds)
+{
+	QElapsedTimer timer;
+	timer.start();
+	volatile unsigned int value = 0;
+	while (timer.nsecsElapsed() < microseconds * 1000ll)
+	{
+		value = value * 1664525u + 1013904223u;
+	}
+}
+
+//!
+//! Empty tasks throughput.
+//!
+static QJsonObject EmptyTasks(const Executor & executor, int tasks)
+{
+	auto latch = std::make_shared< Latch >(tasks);
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < tasks; ++i)
+	{
+		executor.submit([latch] (void) { latch->CountDown(); });
+	}
+	latch->Wait();
+	const double seconds = timer.nsecsElapsed() / 1e9;
+	return {
+		{ "tasks",			tasks },
+		{ "seconds",		seconds },
+		{ "tasksPerSecond",	tasks / seconds },
+		{ "nsPerTask",		seconds * 1e9 / tasks },
+	};
+}
+
+//!
+//! Fan-out / fan-in latency: push a batch of tasks and wait for all of them, a number of times.
+//!
+static QJsonObject FanOutFanIn(const Executor & executor, int tasks)
+{
+	const int width = 64;
+	const int rounds = qMax(1, tasks / width);
+	std::vector< double > latencies;
+	latencies.reserve(rounds);
+	for (int round = 0; round < rounds; ++round)
+	{
+		auto latch = std::make_shared< Latch >(width);
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < width; ++i)
+		{
+			executor.submit([latch] (void) { Spin(5); latch->CountDown(); });
+		}
+		latch->Wait();
+		latencies.push_back(timer.nsecsElapsed() / 1e3);
+	}
+	return {
+		{ "rounds",		rounds },
+		{ "width",		width },
+		{ "p50Us",		Percentile(latencies, 0.5) },
+		{ "p90Us",		Percentile(latencies, 0.9) },
+		{ "p99Us",		Percentile(latencies, 0.99) },
+	};
+}
+
+//!
+//! Task of the nested workload: spawn two children until @p depth is reached.
+//!
+static void Spawn(const Executor & executor, const std::shared_ptr< Latch > & latch, int level, int depth)
+{
+	if (level < depth)
+	{
+		executor.submit([&executor, latch, level, depth] (void) { Spawn(executor, latch, level + 1, depth); });
+		executor.submit([&executor, latch, level, depth] (void) { Spawn(executor, latch, level + 1, depth); });
+	}
+	latch->CountDown();
+}
+
+//!
+//! Nested spawning: each task spawns two children until a given depth is reached.
+//!
+static QJsonObject Nested(const Executor & executor, int tasks)
+{
+	int depth = 0;
+	while ((2 << (depth + 1)) - 1 <= tasks)
+	{
+		++depth;
+	}
+	const int total = (2 << depth) - 1;
+
+	auto latch = std::make_shared< Latch >(total);
+	QElapsedTimer timer;
+	timer.start();
+	executor.submit([&executor, latch, depth] (void) { Spawn(executor, latch, 0, depth); });
+	latch->Wait();
+	const double seconds = timer.nsecsElapsed() / 1e9;
+	return {
+		{ "tasks",			total },
+		{ "depth",			depth },
+		{ "seconds",		seconds },
+		{ "tasksPerSecond",	total / seconds },
+	};
+}
+
+//!
+//! Mixed workload: 3 out of 4 tasks burn CPU, the last one blocks (simulating I/O)
+//!
+static QJsonObject Mixed(const Executor & executor, int tasks)
+{
+	tasks = qMax(4, tasks / 100);
+	auto latch = std::make_shared< Latch >(tasks);
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < tasks; ++i)
+	{
+		if (i % 4 == 3)
+		{
+			executor.submit([latch] (void) { QThread::usleep(1000); latch->CountDown(); });
+		}
+		else
+		{
+			executor.submit([latch] (void) { Spin(200); latch->CountDown(); });
+		}
+	}
+	latch->Wait();
+	const double seconds = timer.nsecsElapsed() / 1e9;
+	return {
+		{ "tasks",			tasks },
+		{ "seconds",		seconds },
+		{ "tasksPerSecond",	tasks / seconds },
+	};
+}
+
+//!
+//! Entry point.
+//!
+int main(int argc, char ** argv)
+{
+	QCoreApplication application(argc, argv);
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption({ "threads", "Maximum number of threads.", "count", QString::number(QThread::idealThreadCount() * 2) });
+	parser.addOption({ "tasks", "Number of tasks per workload.", "count", "100000" });
+	parser.addOption({ "output", "Output JSON file (standard output if not set)", "file" });
+	parser.process(application);
+
+	const int maxThreads	= qMax(1, parser.value("threads").toInt());
+	const int tasks			= qMax(1, parser.value("tasks").toInt());
+
+	const std::vector< std::pair< QString, std::function< QJsonObject (const Executor &, int) > > > workloads = {
+		{ "empty",		EmptyTasks },
+		{ "fanOutFanIn",	FanOutFanIn },
+		{ "nested",		Nested },
+		{ "mixed",		Mixed },
+	};
+
+	QJsonArray results;
+	for (int threads = 1; threads <= maxThreads; ++threads)
+	{
+		QThreadPool::globalInstance()->setMaxThreadCount(threads);
+		StdThreadPool stdPool(threads);
+
+		const std::vector< Executor > executors = {
+			{ "Job",			[] (std::function< void (void) > task) { new Job(task); } },
+			{ "QtConcurrent",	[] (std::function< void (void) > task) { QtConcurrent::run(task); } },
+			{ "std::thread",	[&stdPool] (std::function< void (void) > task) { stdPool.Submit(std::move(task)); } },
+		};
+
+		for (const auto & workload : workloads)
+		{
+			for (const Executor & executor : executors)
+			{
+				QJsonObject result = workload.second(executor, tasks);
+				result.insert("workload", workload.first);
+				result.insert("executor", executor.name);
+				result.insert("threads", threads);
+				results.append(result);
+			}
+		}
+	}
+
+	const QJsonObject output{
+		{ "benchmark",		"QtUtils_JobBench" },
+		{ "idealThreads",	QThread::idealThreadCount() },
+		{ "results",		results },
+	};
+	if (WriteResults(output, parser.value("output")) == false)
+	{
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,332 @@
+#include "./LocalHttpServer.h"
+
+#include <QHostAddress>
+#include <QMutexLocker>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+
+
+//!
+//! Constructor. The server is not started.
+//!
+LocalHttpServer::LocalHttpServer(void)
+	: m_Server(nullptr)
+	, m_Port(0)
+{
+	m_Thread.setObjectName("LocalHttpServer");
+}
+
+//!
+//! Destructor. Stops the server.
+//!
+LocalHttpServer::~LocalHttpServer(void)
+{
+	if (m_Server != nullptr)
+	{
+		QMetaObject::invokeMethod(m_Server, [this] (void) { delete m_Server; }, Qt::BlockingQueuedConnection);
+	}
+	m_Thread.quit();
+	m_Thread.wait();
+}
+
+//!
+//! Start listening on a random local port. Returns false on failure.
+//!
+bool LocalHttpServer::Start(void)
+{
+	m_Thread.start();
+
+	bool result = false;
+	m_Server = new QTcpServer;
+	m_Server->moveToThread(&m_Thread);
+	QMetaObject::invokeMethod(m_Server, [this, &result] (void) {
+		QObject::connect(m_Server, &QTcpServer::newConnection, m_Server, [this] (void) {
+			while (QTcpSocket * socket = m_Server->nextPendingConnection())
+			{
+				QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket] (void) { OnReadyRead(socket); });
+				QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+			}
+		});
+		result = m_Server->listen(QHostAddress::LocalHost);
+		m_Port = m_Server->serverPort();
+	}, Qt::BlockingQueuedConnection);
+
+	return result;
+}
+
+//!
+//! Get the port the server is listening on.
+//!
+quint16 LocalHttpServer::GetPort(void) const
+{
+	return m_Port;
+}
+
+//!
+//! Get the full url of @p path on this server.
+//!
+QString LocalHttpServer::GetUrl(const QString & path) const
+{
+	return QString("http://127.0.0.1:%1%2").arg(m_Port).arg(path);
+}
+
+//!
+//! Get the number of requests received for @p path (without the query) since the server
+//! started or the counts were reset.
+//!
+int LocalHttpServer::GetRequestCount(const QString & path) const
+{
+	QMutexLocker lock(&m_Mutex);
+	return m_RequestCounts.value(path, 0);
+}
+
+//!
+//! Reset the request counts, and the ones used to inject failures and stalls.
+//!
+void LocalHttpServer::ResetRequestCounts(void)
+{
+	QMutexLocker lock(&m_Mutex);
+	m_RequestCounts.clear();
+	m_Attempts.clear();
+}
+
+//!
+//! Parse the complete requests received on @p socket.
+//!
+void LocalHttpServer::OnReadyRead(QTcpSocket * socket)
+{
+	QByteArray buffer = socket->property("buffer").toByteArray() + socket->readAll();
+	for (;;)
+	{
+		const int end = buffer.indexOf("\r\n\r\n");
+		if (end == -1)
+		{
+			break;
+		}
+
+		// request line and headers
+		const QByteArray head = buffer.left(end);
+		const int lineEnd = head.indexOf("\r\n");
+		const QList< QByteArray > requestLine = head.left(lineEnd == -1 ? head.size() : lineEnd).split(' ');
+		const QByteArray headers = lineEnd == -1 ? QByteArray() : head.mid(lineEnd + 2);
+
+		// skip the body, if any
+		int bodySize = 0;
+		for (const QByteArray & header : headers.split('\n'))
+		{
+			if (header.toLower().startsWith("content-length:") == true)
+			{
+				bodySize = header.mid(15).trimmed().toInt();
+			}
+		}
+		if (buffer.size() < end + 4 + bodySize)
+		{
+			break;
+		}
+		buffer.remove(0, end + 4 + bodySize);
+
+		if (requestLine.size() >= 2)
+		{
+			Reply(socket, requestLine[0], requestLine[1], headers);
+		}
+	}
+	socket->setProperty("buffer", buffer);
+}
+
+//!
+//! Get the value of a header, or an empty array if it's not there.
+//!
+static QByteArray GetHeader(const QByteArray & headers, const QByteArray & name)
+{
+	for (const QByteArray & header : headers.split('\n'))
+	{
+		const int colon = header.indexOf(':');
+		if (colon != -1 && header.left(colon).trimmed().toLower() == name)
+		{
+			return header.mid(colon + 1).trimmed();
+		}
+	}
+	return QByteArray();
+}
+
+//!
+//! Get the body of a reply of @p size bytes, starting at @p offset. The content only
+//! depends on the offset, so that ranges of the same file are consistent.
+//!
+static QByteArray GetBody(qint64 offset, qint64 size)
+{
+	QByteArray body(static_cast< int >(size), Qt::Uninitialized);
+	for (int i = 0; i < body.size(); ++i)
+	{
+		body[i] = static_cast< char >('a' + (offset + i) % 26);
+	}
+	return body;
+}
+
+//!
+//! Get the reason phrase of a redirection status code.
+//!
+static QByteArray GetRedirectionText(int status)
+{
+	switch (status)
+	{
+		case 301:	return "Moved Permanently";
+		case 303:	return "See Other";
+		case 307:	return "Temporary Redirect";
+		case 308:	return "Permanent Redirect";
+		default:	return "Found";
+	}
+}
+
+//!
+//! Send the reply to a request.
+//!
+void LocalHttpServer::Reply(QTcpSocket * socket, const QByteArray & method, const QByteArray & target, const QByteArray & headers)
+{
+	const QUrlQuery query(QUrl(QString::fromLatin1(target)));
+	const qint64 size	= query.hasQueryItem("size") ? query.queryItemValue("size").toLongLong() : 1024;
+	const int delay		= query.queryItemValue("delay").toInt();
+	const int chunk		= query.queryItemValue("chunk").toInt();
+	const int redirect	= query.queryItemValue("redirect").toInt();
+	const int status	= query.hasQueryItem("status") ? query.queryItemValue("status").toInt() : 302;
+	const QByteArray etag = "\"" + QByteArray::number(size) + "\"";
+	const QByteArray lastModified = "Mon, 01 Jan 2024 00:00:00 GMT";
+	const QString path = QUrl(QString::fromLatin1(target)).path();
+	{
+		QMutexLocker lock(&m_Mutex);
+		++m_RequestCounts[path];
+	}
+
+	// redirect to /payload, or to the same url with one less redirection
+	if (path == "/redirect" || redirect > 0)
+	{
+		QUrlQuery next(query);
+		if (path == "/redirect")
+		{
+			next.removeQueryItem("status");
+		}
+		else
+		{
+			next.removeQueryItem("redirect");
+			next.addQueryItem("redirect", QString::number(redirect - 1));
+		}
+		const QString location = path == "/redirect" ? QString("/payload") : path;
+		Send(socket, "HTTP/1.1 " + QByteArray::number(status) + " " + GetRedirectionText(status) + "\r\n"
+			+ "Location: " + location.toLatin1() + "?" + next.toString(QUrl::FullyEncoded).toLatin1() + "\r\n"
+			+ "Content-Length: 0\r\n"
+			+ "Connection: keep-alive\r\n"
+			+ "\r\n", delay);
+		return;
+	}
+
+	// injected failures and stall, on the first requests of each id
+	int attempt = 0;
+	{
+		QMutexLocker lock(&m_Mutex);
+		attempt = m_Attempts[path + "?" + query.queryItemValue("id")]++;
+	}
+	if (attempt < query.queryItemValue("fail").toInt())
+	{
+		Send(socket, QByteArray("HTTP/1.1 503 Service Unavailable\r\n")
+			+ "Content-Length: 0\r\n"
+			+ "Connection: keep-alive\r\n"
+			+ "\r\n", delay);
+		return;
+	}
+	const int wait = attempt == 0 && query.hasQueryItem("stall") ? query.queryItemValue("stall").toInt() : delay;
+
+	// requested range, ignored if the If-Range validator doesn't match
+	qint64 first = 0, last = size - 1;
+	const QByteArray range = GetHeader(headers, "range");
+	const QByteArray ifRange = GetHeader(headers, "if-range");
+	const bool ranged = range.startsWith("bytes=") == true && (ifRange.isEmpty() == true || ifRange == etag);
+	if (ranged == true)
+	{
+		const QList< QByteArray > bounds = range.mid(6).split('-');
+		first = bounds.value(0).toLongLong();
+		if (bounds.value(1).isEmpty() == false)
+		{
+			last = qMin(last, bounds.value(1).toLongLong());
+		}
+	}
+
+	// validators and freshness, sent with the full replies and the 304
+	const QByteArray caching = "ETag: " + etag + "\r\n"
+		+ "Last-Modified: " + lastModified + "\r\n"
+		+ (query.hasQueryItem("maxage") ? "Cache-Control: max-age=" + query.queryItemValue("maxage").toLatin1() + "\r\n" : QByteArray());
+
+	// conditional request. If-Modified-Since is ignored when If-None-Match is there
+	const QByteArray ifNoneMatch = GetHeader(headers, "if-none-match");
+	const QByteArray ifModifiedSince = GetHeader(headers, "if-modified-since");
+	const bool notModified = ifNoneMatch.isEmpty() == false ? ifNoneMatch == etag : ifModifiedSince == lastModified;
+
+	QByteArray reply;
+	if (ranged == false && notModified == true)
+	{
+		reply = QByteArray("HTTP/1.1 304 Not Modified\r\n")
+			+ caching
+			+ "Connection: keep-alive\r\n"
+			+ "\r\n";
+	}
+	else if (ranged == true && (first > last || first >= size))
+	{
+		reply = QByteArray("HTTP/1.1 416 Range Not Satisfiable\r\n")
+			+ "Content-Range: bytes */" + QByteArray::number(size) + "\r\n"
+			+ "Content-Length: 0\r\n"
+			+ "Connection: keep-alive\r\n"
+			+ "\r\n";
+	}
+	else if (ranged == false && chunk > 0)
+	{
+		reply = QByteArray("HTTP/1.1 200 OK\r\n")
+			+ "Content-Type: application/octet-stream\r\n"
+			+ "Transfer-Encoding: chunked\r\n"
+			+ caching
+			+ "Connection: keep-alive\r\n"
+			+ "\r\n";
+		if (method != "HEAD")
+		{
+			for (qint64 offset = 0; offset < size; offset += chunk)
+			{
+				const qint64 length = qMin(qint64(chunk), size - offset);
+				reply += QByteArray::number(length, 16) + "\r\n" + GetBody(offset, length) + "\r\n";
+			}
+			reply += "0\r\n\r\n";
+		}
+	}
+	else
+	{
+		reply = QByteArray(ranged == true ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n")
+			+ "Content-Type: application/octet-stream\r\n"
+			+ "Content-Length: " + QByteArray::number(last - first + 1) + "\r\n"
+			+ "Accept-Ranges: bytes\r\n"
+			+ caching
+			+ (ranged == true ? "Content-Range: bytes " + QByteArray::number(first) + "-" + QByteArray::number(last) + "/" + QByteArray::number(size) + "\r\n" : QByteArray())
+			+ "Connection: keep-alive\r\n"
+			+ "\r\n";
+		if (method != "HEAD")
+		{
+			reply += GetBody(first, last - first + 1);
+		}
+	}
+
+	Send(socket, reply, wait);
+}
+
+//!
+//! Write @p reply on @p socket, after @p delay milliseconds.
+//!
+void LocalHttpServer::Send(QTcpSocket * socket, const QByteArray & reply, int delay)
+{
+	if (delay > 0)
+	{
+		QTimer::singleShot(delay, socket, [socket, reply] (void) { socket->write(reply); });
+	}
+	else
+	{
+		socket->write(reply);
+	}
+}
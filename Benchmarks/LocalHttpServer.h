@@ -0,0 +1,89 @@
+#ifndef QT_UTILS_LOCAL_HTTP_SERVER_H
+#define QT_UTILS_LOCAL_HTTP_SERVER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+
+QT_BEGIN_NAMESPACE
+class QTcpServer;
+class QTcpSocket;
+QT_END_NAMESPACE
+
+
+//!
+//! Minimal HTTP/1.1 server running in its own thread, used by the benchmarks so that
+//! they don't depend on the internet. Connections are kept alive, and the replies are
+//! controlled by the query of the requested url:
+//!
+//! - `size`	: size of the body, in bytes (1024 by default)
+//! - `delay`	: delay before sending the reply, in milliseconds (0 by default)
+//! - `chunk`	: if set, the body is sent with the chunked transfer encoding, in chunks of that size
+//! - `redirect`	: number of redirections before the actual reply (0 by default)
+//! - `status`	: status code of the redirections (302 by default)
+//! - `maxage`	: if set, the reply has a `Cache-Control: max-age` header with that value
+//! - `fail`	: the first N requests with the same path and `id` are answered with a 503
+//! - `stall`	: the first request with the same path and `id` is delayed by this many
+//!			  milliseconds instead of `delay`, e.g. to trigger hedging
+//!
+//! The `/redirect` path always redirects (with `status`) to `/payload`, with the same query
+//! minus `status`, e.g. `/redirect?status=301&size=10` redirects to `/payload?size=10`.
+//!
+//! The number of requests received for each path is counted, so that the benchmarks can
+//! check which requests actually reached the server.
+//!
+//! Range requests are supported (with If-Range, the ETag being the size of the body), and
+//! the content of the body only depends on the offset, so that ranges are consistent.
+//!
+//! Replies also have a constant Last-Modified header, and conditional requests (If-None-Match
+//! or If-Modified-Since) matching the validators are answered with a 304 Not Modified.
+//!
+//! e.g. `server.GetUrl("/payload?size=65536&delay=10")`
+//!
+class LocalHttpServer
+{
+
+public:
+
+	// constructor / destructor
+	LocalHttpServer(void);
+	~LocalHttpServer(void);
+
+	// API
+	bool		Start(void);
+	quint16		GetPort(void) const;
+	QString		GetUrl(const QString & path) const;
+	int			GetRequestCount(const QString & path) const;
+	void		ResetRequestCounts(void);
+
+private:
+
+	// private API
+	void		OnReadyRead(QTcpSocket * socket);
+	void		Reply(QTcpSocket * socket, const QByteArray & method, const QByteArray & target, const QByteArray & headers);
+	void		Send(QTcpSocket * socket, const QByteArray & reply, int delay);
+
+	//! The thread where the server runs
+	QThread m_Thread;
+
+	//! The server
+	QTcpServer * m_Server;
+
+	//! The listening port
+	quint16 m_Port;
+
+	//! Protects the request counts
+	mutable QMutex m_Mutex;
+
+	//! Number of requests received, by path
+	QHash< QString, int > m_RequestCounts;
+
+	//! Number of requests received, by path and id
+	QHash< QString, int > m_Attempts;
+
+};
+
+
+#endif
@@ -0,0 +1,313 @@
+//!
+//! Headless rendering benchmark of QuickView, meant to catch QML rendering regressions on
+//! machines without a GPU (e.g. CI runners).
+//!
+//! Unless overridden by the `QT_QPA_PLATFORM` and `QT_QUICK_BACKEND` environment variables,
+//! the view is rendered with the `offscreen` platform and the software scene graph backend.
+//! The scene is rendered for `--frames` frames as fast as possible (there's no vertical
+//! synchronization offscreen) and the frame times are reported.
+//!
+//! The scene can be scripted: if its root object has a `benchmarkStep(frame)` function, it's
+//! called before each frame, with the index of the frame. Driving the scene from the frame
+//! index instead of timers and animations makes the rendering deterministic, which is
+//! required for the golden screenshots. When no `--qml` file is given, a built-in scene of
+//! `--items` rotating, semi transparent rectangles with text is used.
+//!
+//! When `--golden` is set, the last frame is compared to the given image. If it doesn't
+//! exist yet (or with `--update-golden`) it's created instead. The benchmark fails if more
+//! than `--max-diff` pixels have a channel differing by more than `--tolerance`.
+//!
+//! Usage: QtUtils_QuickViewBench [--qml file.qml] [--items N] [--frames N] [--warmup N]
+//!			[--size WxH] [--golden file.png] [--update-golden] [--tolerance N] [--max-diff N]
+//!			[--trace trace.json] [--output results.json]
+//!
+
+#include "./BenchmarkUtils.h"
+#include "../QuickView.h"
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QQmlComponent>
+#include <QQmlEngine>
+#include <QQuickItem>
+#include <QSGRendererInterface>
+#include <QTimer>
+
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
+
+#if defined(QT_UTILS_NAMESPACE)
+using namespace QT_UTILS_NAMESPACE;
+#endif
+
+//!
+//! Built-in scene. Everything depends on the frame index, so that it renders the same on
+//! every run.
+//!
+static const char * s_DefaultScene = R"(
+import QtQuick 2.6
+
+Rectangle {
+	id: root
+	color: "#202020"
+
+	property int frame: 0
+	property int count: 100
+
+	function benchmarkStep(index) {
+		frame = index
+	}
+
+	Grid {
+		anchors.fill: parent
+		columns: Math.ceil(Math.sqrt(root.count))
+		Repeater {
+			model: root.count
+			Rectangle {
+				width: root.width / parent.columns
+				height: width
+				rotation: (root.frame * 3 + index * 7) % 360
+				color: Qt.hsla((index / root.count + root.frame / 240) % 1, 0.6, 0.5, 0.7)
+				radius: width / 8
+				Text {
+					anchors.centerIn: parent
+					text: index + ":" + root.frame
+					color: "white"
+				}
+			}
+		}
+	}
+}
+)";
+
+//!
+//! Compare @p image to @p golden and return the number of pixels which have at least one
+//! channel differing by more than @p tolerance, or -1 if the sizes don't match.
+//!
+static qint64 Compare(const QImage & image, const QImage & golden, int tolerance)
+{
+	if (image.size() != golden.size())
+	{
+		return -1;
+	}
+
+	const QImage a = image.convertToFormat(QImage::Format_ARGB32);
+	const QImage b = golden.convertToFormat(QImage::Format_ARGB32);
+	qint64 count = 0;
+	for (int y = 0; y < a.height(); ++y)
+	{
+		const QRgb * lineA = reinterpret_cast< const QRgb * >(a.constScanLine(y));
+		const QRgb * lineB = reinterpret_cast< const QRgb * >(b.constScanLine(y));
+		for (int x = 0; x < a.width(); ++x)
+		{
+			const QRgb pa = lineA[x], pb = lineB[x];
+			if (std::abs(qRed(pa) - qRed(pb)) > tolerance ||
+				std::abs(qGreen(pa) - qGreen(pb)) > tolerance ||
+				std::abs(qBlue(pa) - qBlue(pb)) > tolerance ||
+				std::abs(qAlpha(pa) - qAlpha(pb)) > tolerance)
+			{
+				++count;
+			}
+		}
+	}
+	return count;
+}
+
+//!
+//! Entry point.
+//!
+int main(int argc, char ** argv)
+{
+	// headless by default. Those must be set before the application is created
+	if (qEnvironmentVariableIsSet("QT_QPA_PLATFORM") == false)
+	{
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	}
+	if (qEnvironmentVariableIsSet("QT_QUICK_BACKEND") == false)
+	{
+		QQuickWindow::setSceneGraphBackend(QSGRendererInterface::Software);
+	}
+
+	QGuiApplication application(argc, argv);
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption({ "qml", "Scene to render (built-in scene if not set)", "file" });
+	parser.addOption({ "items", "Number of items of the built-in scene", "count", "100" });
+	parser.addOption({ "frames", "Number of measured frames", "count", "600" });
+	parser.addOption({ "warmup", "Number of frames rendered before measuring", "count", "30" });
+	parser.addOption({ "size", "Size of the view", "WxH", "800x600" });
+	parser.addOption({ "golden", "Golden screenshot of the last frame", "file" });
+	parser.addOption({ "update-golden", "Overwrite the golden screenshot instead of comparing to it" });
+	parser.addOption({ "tolerance", "Maximum difference of a channel for a pixel to be considered identical", "value", "0" });
+	parser.addOption({ "max-diff", "Maximum number of different pixels", "count", "0" });
+	parser.addOption({ "timeout", "Abort if the run takes longer than this, in seconds", "seconds", "300" });
+	parser.addOption({ "trace", "Dump the frame trace of the view to this file", "file" });
+	parser.addOption({ "output", "Output JSON file (standard output if not set)", "file" });
+	parser.process(application);
+
+	const int frames	= qMax(1, parser.value("frames").toInt());
+	const int warmup	= qMax(0, parser.value("warmup").toInt());
+	const QStringList size = parser.value("size").split('x');
+	const int width		= size.size() == 2 ? qMax(1, size[0].toInt()) : 800;
+	const int height	= size.size() == 2 ? qMax(1, size[1].toInt()) : 600;
+
+	QuickView view;
+	view.SetPersistence(QuickView::Persistence(QuickView::PersistenceFlags::None));
+	view.setResizeMode(QQuickView::SizeRootObjectToView);
+
+	// load the scene, synchronously, and measure it
+	QElapsedTimer clock;
+	clock.start();
+	if (parser.isSet("qml") == true)
+	{
+		view.setSource(QUrl::fromLocalFile(QFileInfo(parser.value("qml")).absoluteFilePath()));
+	}
+	else
+	{
+		auto component = new QQmlComponent(view.engine(), &view);
+		component->setData(s_DefaultScene, QUrl("qrc:/QuickViewBench.qml"));
+		QObject * root = component->beginCreate(view.rootContext());
+		if (root != nullptr)
+		{
+			root->setProperty("count", qMax(1, parser.value("items").toInt()));
+		}
+		component->completeCreate();
+		view.setContent(component->url(), component, root);
+	}
+	const double loadMs = clock.nsecsElapsed() / 1e6;
+	if (view.IsReady() == false || view.rootObject() == nullptr)
+	{
+		qCritical() << "Couldn't load the scene:" << view.errors();
+		return 1;
+	}
+
+	QObject * root = view.rootObject();
+	const bool scripted = root->metaObject()->indexOfMethod("benchmarkStep(QVariant)") != -1;
+
+	// render the frames back to back: each swapped frame steps the scene and requests the next one
+	std::vector< double > intervals;
+	intervals.reserve(frames);
+	QElapsedTimer frameClock;
+	qint64 last = 0;
+	int frame = 0;
+	QEventLoop loop;
+	auto step = [&] (void) {
+		if (scripted == true)
+		{
+			QMetaObject::invokeMethod(root, "benchmarkStep", Q_ARG(QVariant, frame));
+		}
+		view.update();
+	};
+	QObject::connect(&view, &QQuickWindow::frameSwapped, &loop, [&] (void) {
+		const qint64 now = frameClock.nsecsElapsed();
+		if (frame == warmup)
+		{
+			view.SetFrameTimingEnabled(true);
+		}
+		else if (frame > warmup)
+		{
+			intervals.push_back((now - last) / 1e6);
+		}
+		last = now;
+		if (++frame > warmup + frames)
+		{
+			loop.quit();
+			return;
+		}
+		step();
+	}, Qt::QueuedConnection);
+	QTimer::singleShot(parser.value("timeout").toInt() * 1000, &loop, [&] (void) { loop.exit(1); });
+
+	view.resize(width, height);
+	view.show();
+	frameClock.start();
+	step();
+	if (loop.exec() != 0)
+	{
+		qCritical("Timeout after %d frames", frame);
+		return 1;
+	}
+	const double totalMs = std::accumulate(intervals.begin(), intervals.end(), 0.0);
+	const QuickView::FrameStats stats = view.GetFrameStats();
+
+	if (parser.isSet("trace") == true && view.DumpFrameTrace(parser.value("trace")) == false)
+	{
+		qCritical("Couldn't write %s", qPrintable(parser.value("trace")));
+	}
+
+	QJsonObject result{
+		{ "frames",				static_cast< int >(intervals.size()) },
+		{ "loadMs",				loadMs },
+		{ "totalMs",			totalMs },
+		{ "fps",				totalMs > 0.0 ? intervals.size() / (totalMs / 1000.0) : 0.0 },
+		{ "syncMs",				stats.syncTime },
+		{ "renderMs",			stats.renderTime },
+	};
+	std::sort(intervals.begin(), intervals.end());
+	result.insert("frameTimeP50", Percentile(intervals, 0.5));
+	result.insert("frameTimeP90", Percentile(intervals, 0.9));
+	result.insert("frameTimeP99", Percentile(intervals, 0.99));
+	result.insert("frameTimeMax", intervals.empty() == true ? 0.0 : intervals.back());
+
+	// golden screenshot of the last frame
+	int status = 0;
+	if (parser.isSet("golden") == true)
+	{
+		const QString golden = parser.value("golden");
+		const QImage image = view.grabWindow();
+		QJsonObject check{ { "file", golden } };
+		if (parser.isSet("update-golden") == true || QFile::exists(golden) == false)
+		{
+			const bool saved = image.save(golden);
+			check.insert("created", saved);
+			if (saved == false)
+			{
+				qCritical("Couldn't write %s", qPrintable(golden));
+				status = 1;
+			}
+		}
+		else
+		{
+			const qint64 different = Compare(image, QImage(golden), parser.value("tolerance").toInt());
+			const bool match = different != -1 && different <= parser.value("max-diff").toLongLong();
+			check.insert("differentPixels", static_cast< double >(different));
+			check.insert("match", match);
+			if (match == false)
+			{
+				const QString actual = QFileInfo(golden).path() + "/" + QFileInfo(golden).completeBaseName() + ".actual.png";
+				image.save(actual);
+				check.insert("actual", actual);
+				status = 2;
+			}
+		}
+		result.insert("golden", check);
+	}
+
+	const QJsonObject output{
+		{ "benchmark",	"QtUtils_QuickViewBench" },
+		{ "scene",		parser.isSet("qml") == true ? parser.value("qml") : QString("built-in") },
+		{ "platform",	QGuiApplication::platformName() },
+		{ "backend",	QQuickWindow::sceneGraphBackend().isEmpty() == true ? QString("default") : QQuickWindow::sceneGraphBackend() },
+		{ "width",		width },
+		{ "height",		height },
+		{ "scripted",	scripted },
+		{ "results",	result },
+	};
+	if (WriteResults(output, parser.value("output")) == false)
+	{
+		return 1;
+	}
+
+	return status;
+}
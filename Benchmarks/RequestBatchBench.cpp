@@ -0,0 +1,159 @@
+//!
+//! Benchmark of RequestBatch against firing all the requests at once with RequestUrl,
+//! using a local HTTP server.
+//!
+//! A number of requests are queued at once, then a few of them (the "visible" ones) are
+//! promoted. For each strategy, the total throughput and the latency percentiles of both
+//! the promoted and the other requests are written as JSON, either on the standard output
+//! or in the file given with `--output`.
+//!
+//! Usage: QtUtils_RequestBatchBench [--requests N] [--size BYTES] [--delay MS] [--output results.json]
+//!
+
+#include "./BenchmarkUtils.h"
+#include "./LocalHttpServer.h"
+#include "../RequestBatch.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSemaphore>
+
+#include <algorithm>
+#include <vector>
+
+
+#if defined(QT_UTILS_NAMESPACE)
+using namespace QT_UTILS_NAMESPACE;
+#endif
+
+//!
+//! Latencies of a run, in milliseconds.
+//!
+struct Latencies
+{
+	QMutex mutex;
+	std::vector< double > promoted;
+	std::vector< double > others;
+	int failed = 0;
+};
+
+//!
+//! Build the JSON result of a run.
+//!
+static QJsonObject ToJson(const QString & strategy, int requests, double seconds, const Latencies & latencies)
+{
+	return {
+		{ "strategy",			strategy },
+		{ "requests",			requests },
+		{ "failed",				latencies.failed },
+		{ "seconds",			seconds },
+		{ "requestsPerSecond",	requests / seconds },
+		{ "promotedP50Ms",		Percentile(latencies.promoted, 0.5) },
+		{ "promotedP99Ms",		Percentile(latencies.promoted, 0.99) },
+		{ "othersP50Ms",		Percentile(latencies.others, 0.5) },
+		{ "othersP99Ms",		Percentile(latencies.others, 0.99) },
+	};
+}
+
+//!
+//! Entry point.
+//!
+int main(int argc, char ** argv)
+{
+	QCoreApplication application(argc, argv);
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption({ "requests", "Number of requests.", "count", "2000" });
+	parser.addOption({ "promoted", "Number of promoted requests.", "count", "20" });
+	parser.addOption({ "size", "Size of each reply, in bytes.", "bytes", "16384" });
+	parser.addOption({ "delay", "Server side delay of each reply, in milliseconds.", "ms", "5" });
+	parser.addOption({ "output", "Output JSON file (standard output if not set)", "file" });
+	parser.process(application);
+
+	const int requests	= qMax(1, parser.value("requests").toInt());
+	const int promoted	= qBound(0, parser.value("promoted").toInt(), requests);
+	const int size		= qMax(0, parser.value("size").toInt());
+	const int delay		= qMax(0, parser.value("delay").toInt());
+
+	LocalHttpServer server;
+	if (server.Start() == false)
+	{
+		qCritical("Couldn't start the local server");
+		return 1;
+	}
+
+	// the urls. Each one is unique so that they're not coalesced, and the promoted ones are at the end
+	QStringList urls;
+	for (int i = 0; i < requests; ++i)
+	{
+		urls << server.GetUrl(QString("/payload?size=%1&delay=%2&id=%3").arg(size).arg(delay).arg(i));
+	}
+	auto isPromoted = [&] (int index) { return index >= requests - promoted; };
+
+	QJsonArray results;
+
+	// everything at once, no priority
+	{
+		Latencies latencies;
+		QSemaphore done;
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < requests; ++i)
+		{
+			auto record = [&, i] (bool success) {
+				QMutexLocker lock(&latencies.mutex);
+				(isPromoted(i) ? latencies.promoted : latencies.others).push_back(timer.nsecsElapsed() / 1e6);
+				latencies.failed += success ? 0 : 1;
+				done.release();
+			};
+			RequestUrl(urls[i], [record] (QByteArray) { record(true); }, [record] (QNetworkReply::NetworkError, QString) { record(false); });
+		}
+		done.acquire(requests);
+		results.append(ToJson("RequestUrl", requests, timer.nsecsElapsed() / 1e9, latencies));
+	}
+
+	// batch, with the promoted requests moved to the front of the queue
+	{
+		Latencies latencies;
+		QSemaphore done;
+		RequestBatch batch(8, 8);
+		std::vector< int > ids(requests);
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < requests; ++i)
+		{
+			auto record = [&, i] (bool success) {
+				QMutexLocker lock(&latencies.mutex);
+				(isPromoted(i) ? latencies.promoted : latencies.others).push_back(timer.nsecsElapsed() / 1e6);
+				latencies.failed += success ? 0 : 1;
+				done.release();
+			};
+			ids[i] = batch.Add(urls[i], [record] (QByteArray) { record(true); }, [record] (QNetworkReply::NetworkError, QString) { record(false); });
+		}
+		for (int i = requests - promoted; i < requests; ++i)
+		{
+			batch.SetPriority(ids[i], 1);
+		}
+		done.acquire(requests);
+		results.append(ToJson("RequestBatch", requests, timer.nsecsElapsed() / 1e9, latencies));
+	}
+
+	const QJsonObject output{
+		{ "benchmark",	"QtUtils_RequestBatchBench" },
+		{ "size",		size },
+		{ "delay",		delay },
+		{ "results",	results },
+	};
+	if (WriteResults(output, parser.value("output")) == false)
+	{
+		return 1;
+	}
+
+	return 0;
+}
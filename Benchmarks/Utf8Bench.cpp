@@ -0,0 +1,139 @@
+//!
+//! Throughput benchmark of the UTF-8 conversions against QString::fromUtf8 and
+//! QString::toUtf8, for each implementation supported by the CPU (scalar, SSE2, AVX2).
+//!
+//! The texts are generated in memory, so this only measures the conversions:
+//!
+//! - `ascii`	: English text, pure ASCII
+//! - `latin`	: French like text, mostly ASCII with a few accented letters
+//! - `cjk`		: Chinese like text, only 3 bytes sequences
+//! - `mixed`	: ASCII text with a few emojis (4 bytes sequences, surrogate pairs in UTF-16)
+//!
+//! Usage: QtUtils_Utf8Bench [--size MB] [--iterations N] [--output results.json]
+//!
+
+#include "./BenchmarkUtils.h"
+#include "../Utf8.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+
+#if defined(QT_UTILS_NAMESPACE)
+using namespace QT_UTILS_NAMESPACE;
+#endif
+
+//!
+//! Build a text of about @p size bytes by repeating @p pattern.
+//!
+static QByteArray CreateText(const QString & pattern, int size)
+{
+	const QByteArray block = pattern.toUtf8();
+	QByteArray text;
+	text.reserve(size + block.size());
+	while (text.size() < size)
+	{
+		text += block;
+	}
+	return text;
+}
+
+//!
+//! Entry point.
+//!
+int main(int argc, char ** argv)
+{
+	QCoreApplication application(argc, argv);
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption({ "size", "Size of each text, in MB.", "size", "64" });
+	parser.addOption({ "iterations", "Number of iterations of each measure (the median is kept)", "count", "5" });
+	parser.addOption({ "output", "Output JSON file (standard output if not set)", "file" });
+	parser.process(application);
+
+	const int size			= qBound(1, parser.value("size").toInt(), 512) * 1024 * 1024;
+	const int iterations	= qMax(1, parser.value("iterations").toInt());
+
+	const std::vector< std::pair< QString, QString > > texts = {
+		{ "ascii",	"The quick brown fox jumps over the lazy dog. 0123456789\n" },
+		{ "latin",	QString::fromUtf8("L'\xC3\xA9t\xC3\xA9 dernier, nous \xC3\xA9tions \xC3\xA0 la for\xC3\xAAt avec le ma\xC3\xAEtre d'h\xC3\xB4tel.\n") },
+		{ "cjk",	QString::fromUtf8("\xE6\x95\x8F\xE6\x8D\xB7\xE7\x9A\x84\xE6\xA3\x95\xE8\x89\xB2\xE7\x8B\x90\xE7\x8B\xB8\xE8\xB7\xB3\xE8\xBF\x87\xE4\xBA\x86\xE9\x82\xA3\xE5\x8F\xAA\xE6\x87\x92\xE7\x8B\x97\xE3\x80\x82\n") },
+		{ "mixed",	QString::fromUtf8("The quick brown fox \xF0\x9F\xA6\x8A jumps over the lazy dog \xF0\x9F\x90\xB6 and runs away.\n") },
+	};
+
+	const Utf8Implementation initial = GetUtf8Implementation();
+	const std::vector< std::pair< QString, Utf8Implementation > > implementations = {
+		{ "scalar",	Utf8Implementation::Scalar },
+		{ "sse2",	Utf8Implementation::SSE2 },
+		{ "avx2",	Utf8Implementation::AVX2 },
+	};
+
+	QJsonArray results;
+	quint64 checksum = 0;
+	for (const auto & text : texts)
+	{
+		const QByteArray bytes = CreateText(text.second, size);
+		const QString string = QString::fromUtf8(bytes);
+
+		QJsonObject result{ { "text", text.first } };
+		auto add = [&] (const QString & name, double ms) {
+			result.insert(name + "Ms", ms);
+			result.insert(name + "MBps", bytes.size() / (1024.0 * 1024.0) / (ms / 1000.0));
+		};
+
+		// Qt references
+		add("fromUtf8", Measure(iterations, checksum, [&] (void) {
+			return static_cast< quint64 >(QString::fromUtf8(bytes).size());
+		}));
+		add("toUtf8", Measure(iterations, checksum, [&] (void) {
+			return static_cast< quint64 >(string.toUtf8().size());
+		}));
+
+		// our implementations
+		for (const auto & implementation : implementations)
+		{
+			if (SetUtf8Implementation(implementation.second) == false)
+			{
+				continue;
+			}
+			const QString & name = implementation.first;
+			add(name + "Validate", Measure(iterations, checksum, [&] (void) {
+				return static_cast< quint64 >(IsValidUtf8(bytes.constData(), bytes.size()));
+			}));
+			add(name + "Decode", Measure(iterations, checksum, [&] (void) {
+				return static_cast< quint64 >(DecodeUtf8(bytes).size());
+			}));
+			add(name + "DecodeStrict", Measure(iterations, checksum, [&] (void) {
+				return static_cast< quint64 >(DecodeUtf8(bytes, Utf8Mode::Strict).size());
+			}));
+			add(name + "Encode", Measure(iterations, checksum, [&] (void) {
+				return static_cast< quint64 >(EncodeUtf8(string).size());
+			}));
+		}
+		SetUtf8Implementation(initial);
+
+		results.append(result);
+	}
+
+	const QJsonObject output{
+		{ "benchmark",	"QtUtils_Utf8Bench" },
+		{ "sizeMB",		size / (1024 * 1024) },
+		{ "iterations",	iterations },
+		{ "checksum",	QString::number(checksum) },
+		{ "results",	results },
+	};
+	if (WriteResults(output, parser.value("output")) == false)
+	{
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,916 @@
+#include "./DownloadManager.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QSaveFile>
+#include <QThread>
+#include <QTimer>
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+
+QT_UTILS_NAMESPACE_BEGIN
+
+	//! Read buffer size of the replies, which is also the maximum size read at once
+	static constexpr qint64 s_ChunkSize = 64 * 1024;
+
+	//! The progress is saved each time this number of bytes was written
+	static constexpr qint64 s_SaveInterval = 4 * 1024 * 1024;
+
+	//!
+	//! Token bucket used to cap a bandwidth. It holds up to a quarter of a second worth of
+	//! tokens, which allows small bursts while keeping the average rate.
+	//!
+	struct TokenBucket
+	{
+		//! The rate in bytes per second, or 0 for no cap
+		qint64 rate = 0;
+
+		//! Available tokens
+		double tokens = 0.0;
+
+		//! Time of the last refill
+		QElapsedTimer timer;
+
+		//!
+		//! Change the rate.
+		//!
+		void SetRate(qint64 bytesPerSecond)
+		{
+			Refill();
+			rate = qMax(qint64(0), bytesPerSecond);
+			tokens = qMin(tokens, static_cast< double >(GetCapacity()));
+		}
+
+		//!
+		//! Get the maximum number of tokens.
+		//!
+		qint64 GetCapacity(void) const
+		{
+			return qMax(s_ChunkSize, rate / 4);
+		}
+
+		//!
+		//! Add the tokens accumulated since the last refill.
+		//!
+		void Refill(void)
+		{
+			if (timer.isValid() == false)
+			{
+				tokens = static_cast< double >(GetCapacity());
+			}
+			else if (rate > 0)
+			{
+				tokens = qMin(static_cast< double >(GetCapacity()), tokens + timer.nsecsElapsed() * static_cast< double >(rate) / 1e9);
+			}
+			timer.start();
+		}
+
+		//!
+		//! Get the number of bytes that can be consumed right now.
+		//!
+		qint64 GetAvailable(void)
+		{
+			if (rate <= 0)
+			{
+				return std::numeric_limits< qint64 >::max();
+			}
+			Refill();
+			return static_cast< qint64 >(tokens);
+		}
+
+		//!
+		//! Consume @p bytes tokens.
+		//!
+		void Consume(qint64 bytes)
+		{
+			if (rate > 0)
+			{
+				tokens -= static_cast< double >(bytes);
+			}
+		}
+
+		//!
+		//! Get the delay in milliseconds until a reasonable chunk can be consumed.
+		//!
+		int GetDelay(void) const
+		{
+			if (rate <= 0)
+			{
+				return 0;
+			}
+			const double missing = qMax(0.0, s_ChunkSize / 4 - tokens);
+			return qMax(1, static_cast< int >(std::ceil(missing * 1000.0 / rate)));
+		}
+	};
+
+	//!
+	//! A segment of a download.
+	//!
+	struct Segment
+	{
+		//! Offset of the first byte of the segment
+		qint64 start = 0;
+
+		//! Offset of the last byte of the segment, or -1 if it's not known
+		qint64 end = -1;
+
+		//! Number of bytes written so far
+		qint64 written = 0;
+
+		//! Set when the whole segment was written
+		bool complete = false;
+
+		//! The current reply, if any
+		QPointer< QNetworkReply > reply;
+
+		//! The file, opened while the segment is downloaded
+		std::shared_ptr< QFile > file;
+
+		//! Set once the headers of the reply have been checked
+		bool accepted = false;
+
+		//! Set when the reply is finished
+		bool finished = false;
+
+		//! Set while the segment waits for bandwidth
+		bool waiting = false;
+	};
+
+	//!
+	//! A download. Apart from its id, only used from the thread of its network manager.
+	//!
+	struct Transfer
+	{
+		int id = 0;
+		QUrl url;
+		QString filename;
+		DownloadManager::Options options;
+		CompletionCallback success;
+		FailureCallback failure;
+		QNetworkAccessManager * networkManager = nullptr;
+
+		//! ETag or Last-Modified header of the file, used as the If-Range validator
+		QByteArray validator;
+
+		//! Size of the file, or -1 if unknown
+		qint64 size = -1;
+
+		//! The segments
+		std::vector< Segment > segments;
+
+		//! Bandwidth cap of the download
+		TokenBucket bucket;
+
+		//! Incremented each time the replies are aborted, to ignore their signals
+		int generation = 0;
+
+		//! Set if the download was restarted from the start
+		bool restarted = false;
+
+		//! Set when the download succeeded, failed or was stopped
+		bool done = false;
+
+		//! Number of bytes written since the progress was last saved
+		qint64 unsaved = 0;
+	};
+
+	//!
+	//! The downloads, and the global bandwidth cap.
+	//!
+	struct DownloadData
+	{
+		//! Protects the data
+		QMutex mutex;
+
+		//! The running downloads, by id
+		QHash< int, std::shared_ptr< Transfer > > transfers;
+
+		//! Next download id
+		int nextId = 0;
+
+		//! Global bandwidth cap
+		TokenBucket bucket;
+	};
+
+	//!
+	//! Get the downloads data.
+	//!
+	static DownloadData & GetData(void)
+	{
+		static DownloadData data;
+		return data;
+	}
+
+	//!
+	//! Get the name of the file holding the data of a download while it's running.
+	//!
+	static inline QString GetPartFilename(const Transfer & transfer)
+	{
+		return transfer.filename + ".part";
+	}
+
+	//!
+	//! Get the name of the file holding the progress of a download.
+	//!
+	static inline QString GetStateFilename(const Transfer & transfer)
+	{
+		return transfer.filename + ".part.json";
+	}
+
+	//!
+	//! Get the validator of the file returned by @p reply: its ETag if it's a strong one, or
+	//! its Last-Modified date.
+	//!
+	static QByteArray GetValidator(QNetworkReply * reply)
+	{
+		const QByteArray etag = reply->rawHeader("ETag");
+		if (etag.isEmpty() == false && etag.startsWith("W/") == false)
+		{
+			return etag;
+		}
+		return reply->rawHeader("Last-Modified");
+	}
+
+	//!
+	//! Parse a `Content-Range: bytes first-last/total` header. @p total is -1 if unknown.
+	//!
+	static bool ParseContentRange(const QByteArray & header, qint64 & first, qint64 & total)
+	{
+		const QByteArray value = header.trimmed();
+		const int dash = value.indexOf('-');
+		const int slash = value.indexOf('/');
+		if (value.startsWith("bytes ") == false || dash == -1 || slash < dash)
+		{
+			return false;
+		}
+		bool ok = false;
+		first = value.mid(6, dash - 6).trimmed().toLongLong(&ok);
+		if (ok == false)
+		{
+			return false;
+		}
+		total = value.mid(slash + 1).trimmed().toLongLong(&ok);
+		if (ok == false)
+		{
+			total = -1;
+		}
+		return true;
+	}
+
+	//!
+	//! Save the progress of a download, so that it can be resumed.
+	//!
+	static void SaveState(Transfer & transfer)
+	{
+		// the progress must never be ahead of the data
+		QJsonArray segments;
+		for (const Segment & segment : transfer.segments)
+		{
+			if (segment.file != nullptr)
+			{
+				segment.file->flush();
+			}
+			segments.append(QJsonObject{
+				{ "start",		static_cast< double >(segment.start) },
+				{ "end",		static_cast< double >(segment.end) },
+				{ "written",	static_cast< double >(segment.written) },
+			});
+		}
+
+		QSaveFile file(GetStateFilename(transfer));
+		if (file.open(QIODevice::WriteOnly) == true)
+		{
+			file.write(QJsonDocument(QJsonObject{
+				{ "url",		transfer.url.toString(QUrl::FullyEncoded) },
+				{ "validator",	QString::fromLatin1(transfer.validator) },
+				{ "size",		static_cast< double >(transfer.size) },
+				{ "segments",	segments },
+			}).toJson(QJsonDocument::Compact));
+			file.commit();
+		}
+		transfer.unsaved = 0;
+	}
+
+	//!
+	//! Load the saved progress of a download. Returns false if there's nothing to resume,
+	//! which is also the case without a validator: a Range request without If-Range could
+	//! append a newer version of the file to the old data.
+	//!
+	static bool LoadState(Transfer & transfer)
+	{
+		QFile file(GetStateFilename(transfer));
+		if (QFile::exists(GetPartFilename(transfer)) == false || file.open(QIODevice::ReadOnly) == false)
+		{
+			return false;
+		}
+
+		const QJsonObject state = QJsonDocument::fromJson(file.readAll()).object();
+		const QJsonArray segments = state.value("segments").toArray();
+		if (state.value("url").toString() != transfer.url.toString(QUrl::FullyEncoded) || segments.isEmpty() == true)
+		{
+			return false;
+		}
+
+		transfer.validator	= state.value("validator").toString().toLatin1();
+		if (transfer.validator.isEmpty() == true)
+		{
+			return false;
+		}
+		transfer.size		= static_cast< qint64 >(state.value("size").toDouble(-1.0));
+		transfer.segments.clear();
+		for (const QJsonValue & value : segments)
+		{
+			const QJsonObject object = value.toObject();
+			Segment segment;
+			segment.start		= static_cast< qint64 >(object.value("start").toDouble());
+			segment.end			= static_cast< qint64 >(object.value("end").toDouble(-1.0));
+			segment.written		= static_cast< qint64 >(object.value("written").toDouble());
+			segment.complete	= segment.end >= 0 && segment.written == segment.end - segment.start + 1;
+			transfer.segments.push_back(segment);
+		}
+		return true;
+	}
+
+	//!
+	//! Forget a download.
+	//!
+	static void Unregister(const Transfer & transfer)
+	{
+		DownloadData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		data.transfers.remove(transfer.id);
+	}
+
+	//!
+	//! Abort the replies of a download, and close its files.
+	//!
+	static void AbortReplies(Transfer & transfer)
+	{
+		++transfer.generation;
+		for (Segment & segment : transfer.segments)
+		{
+			if (segment.reply != nullptr)
+			{
+				segment.reply->abort();
+			}
+			segment.reply = nullptr;
+			if (segment.file != nullptr)
+			{
+				segment.file->flush();
+			}
+		}
+	}
+
+	//!
+	//! Stop a download on error, keeping what was downloaded so far.
+	//!
+	static void Fail(const std::shared_ptr< Transfer > & transfer, QNetworkReply::NetworkError error, const QString & errorString)
+	{
+		if (transfer->done == true)
+		{
+			return;
+		}
+		transfer->done = true;
+		AbortReplies(*transfer);
+		SaveState(*transfer);
+		for (Segment & segment : transfer->segments)
+		{
+			segment.file.reset();
+		}
+		Unregister(*transfer);
+		transfer->failure(error, errorString);
+	}
+
+	//!
+	//! Move the downloaded file to its final location.
+	//!
+	static void Complete(const std::shared_ptr< Transfer > & transfer)
+	{
+		transfer->done = true;
+		qint64 size = 0;
+		for (Segment & segment : transfer->segments)
+		{
+			size += segment.written;
+			segment.file.reset();
+		}
+
+		Unregister(*transfer);
+		QFile::remove(transfer->filename);
+		if (QFile::rename(GetPartFilename(*transfer), transfer->filename) == false)
+		{
+			transfer->failure(QNetworkReply::UnknownContentError, QString("Couldn't create %1").arg(transfer->filename));
+			return;
+		}
+		QFile::remove(GetStateFilename(*transfer));
+		transfer->success(size);
+	}
+
+	//!
+	//! Report the progress of a download.
+	//!
+	static void ReportProgress(const Transfer & transfer)
+	{
+		if (transfer.options.progress)
+		{
+			qint64 received = 0;
+			for (const Segment & segment : transfer.segments)
+			{
+				received += segment.written;
+			}
+			transfer.options.progress(received, transfer.size);
+		}
+	}
+
+	//!
+	//! Create the request of a download.
+	//!
+	static QNetworkRequest CreateRequest(const Transfer & transfer)
+	{
+		QNetworkRequest request(transfer.url);
+		request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+
+		// ranges are offsets in the encoded data, so don't let the server compress it
+		request.setRawHeader("Accept-Encoding", "identity");
+		return request;
+	}
+
+	// forward declarations
+	static void StartSegments(const std::shared_ptr< Transfer > & transfer);
+	static void Pump(const std::shared_ptr< Transfer > & transfer, size_t index, int generation);
+
+	//!
+	//! Download the whole file again from the start, e.g. because it changed on the server.
+	//! This is only done once per download.
+	//!
+	static void Restart(const std::shared_ptr< Transfer > & transfer)
+	{
+		if (transfer->restarted == true)
+		{
+			Fail(transfer, QNetworkReply::ContentConflictError, "The file keeps changing on the server");
+			return;
+		}
+		transfer->restarted = true;
+		AbortReplies(*transfer);
+		transfer->segments.clear();
+		transfer->segments.push_back(Segment());
+		transfer->validator.clear();
+		transfer->size = -1;
+		QFile::remove(GetPartFilename(*transfer));
+		StartSegments(transfer);
+	}
+
+	//!
+	//! Check the headers of the reply of a segment. Returns false if the download was restarted.
+	//!
+	static bool Accept(const std::shared_ptr< Transfer > & transfer, size_t index)
+	{
+		Segment & segment = transfer->segments[index];
+		QNetworkReply * reply = segment.reply;
+		const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+		if (status == 206)
+		{
+			qint64 first = 0, total = -1;
+			if (ParseContentRange(reply->rawHeader("Content-Range"), first, total) == false ||
+				first != segment.start + segment.written ||
+				(transfer->size >= 0 && total >= 0 && total != transfer->size))
+			{
+				Restart(transfer);
+				return false;
+			}
+			transfer->size = total >= 0 ? total : transfer->size;
+			if (segment.end < 0 && transfer->size >= 0)
+			{
+				segment.end = transfer->size - 1;
+			}
+		}
+		else if (status == 200)
+		{
+			// the server sent the whole file: either it doesn't support ranges, or the file changed
+			if (transfer->segments.size() > 1)
+			{
+				Restart(transfer);
+				return false;
+			}
+			if (segment.written > 0)
+			{
+				segment.file->resize(0);
+				segment.file->seek(0);
+				segment.written = 0;
+			}
+			transfer->validator = GetValidator(reply);
+			const QVariant length = reply->header(QNetworkRequest::ContentLengthHeader);
+			transfer->size = length.isValid() == true ? length.toLongLong() : -1;
+			segment.end = -1;
+		}
+		else if (status == 416)
+		{
+			// the saved progress doesn't match the file anymore
+			Restart(transfer);
+			return false;
+		}
+		else
+		{
+			// redirections are handled by Qt, and errors when the reply is finished
+			return true;
+		}
+		segment.accepted = true;
+		return true;
+	}
+
+	//!
+	//! Check the end of a segment, and complete the download if it was the last one.
+	//!
+	static void FinishSegment(const std::shared_ptr< Transfer > & transfer, size_t index)
+	{
+		Segment & segment = transfer->segments[index];
+		QNetworkReply * reply = segment.reply;
+		segment.reply = nullptr;
+		reply->deleteLater();
+
+		if (reply->error() != QNetworkReply::NoError)
+		{
+			Fail(transfer, reply->error(), reply->errorString());
+			return;
+		}
+
+		// the connection might have been closed early
+		if (segment.end >= 0 && segment.written != segment.end - segment.start + 1)
+		{
+			Fail(transfer, QNetworkReply::RemoteHostClosedError, "Incomplete download");
+			return;
+		}
+		if (segment.end < 0)
+		{
+			segment.end = segment.start + segment.written - 1;
+			transfer->size = segment.start + segment.written;
+		}
+		segment.complete = true;
+		segment.file.reset();
+
+		for (const Segment & other : transfer->segments)
+		{
+			if (other.complete == false)
+			{
+				return;
+			}
+		}
+		Complete(transfer);
+	}
+
+	//!
+	//! Write the data received by a segment, as fast as the bandwidth caps allow.
+	//!
+	static void Pump(const std::shared_ptr< Transfer > & transfer, size_t index, int generation)
+	{
+		if (transfer->done == true || transfer->generation != generation)
+		{
+			return;
+		}
+
+		Segment & segment = transfer->segments[index];
+		QNetworkReply * reply = segment.reply;
+		while (reply->bytesAvailable() > 0)
+		{
+			// take the tokens of both buckets
+			qint64 allowed = qMin(qMin(reply->bytesAvailable(), s_ChunkSize), transfer->bucket.GetAvailable());
+			int delay = transfer->bucket.GetDelay();
+			{
+				DownloadData & data = GetData();
+				QMutexLocker lock(&data.mutex);
+				allowed = qMin(allowed, data.bucket.GetAvailable());
+				delay = qMax(delay, data.bucket.GetDelay());
+				if (allowed > 0)
+				{
+					data.bucket.Consume(allowed);
+				}
+			}
+
+			// and wait for more if there's not enough
+			if (allowed <= 0)
+			{
+				segment.waiting = true;
+				QTimer::singleShot(delay, reply, [transfer, index, generation] (void) {
+					if (transfer->generation == generation)
+					{
+						transfer->segments[index].waiting = false;
+						Pump(transfer, index, generation);
+					}
+				});
+				return;
+			}
+			transfer->bucket.Consume(allowed);
+
+			const QByteArray data = reply->read(allowed);
+			if (segment.file->write(data) != data.size())
+			{
+				Fail(transfer, QNetworkReply::UnknownContentError, segment.file->errorString());
+				return;
+			}
+			segment.written += data.size();
+			transfer->unsaved += data.size();
+			ReportProgress(*transfer);
+		}
+
+		if (transfer->unsaved >= s_SaveInterval)
+		{
+			SaveState(*transfer);
+		}
+		if (segment.finished == true)
+		{
+			FinishSegment(transfer, index);
+		}
+	}
+
+	//!
+	//! Send the request of a segment.
+	//!
+	static void StartSegment(const std::shared_ptr< Transfer > & transfer, size_t index)
+	{
+		Segment & segment = transfer->segments[index];
+		const int generation = transfer->generation;
+
+		// open the file at the right position
+		segment.file = std::make_shared< QFile >(GetPartFilename(*transfer));
+		if (segment.file->open(QIODevice::ReadWrite) == false || segment.file->seek(segment.start + segment.written) == false)
+		{
+			Fail(transfer, QNetworkReply::UnknownContentError, segment.file->errorString());
+			return;
+		}
+
+		// request the missing part
+		QNetworkRequest request = CreateRequest(*transfer);
+		const qint64 first = segment.start + segment.written;
+		if (first > 0 || segment.end >= 0)
+		{
+			request.setRawHeader("Range", "bytes=" + QByteArray::number(first) + "-" + (segment.end >= 0 ? QByteArray::number(segment.end) : QByteArray()));
+			if (transfer->validator.isEmpty() == false)
+			{
+				request.setRawHeader("If-Range", transfer->validator);
+			}
+		}
+
+		// send
+		QNetworkReply * reply = transfer->networkManager->get(request);
+		reply->setReadBufferSize(s_ChunkSize);
+		segment.reply		= reply;
+		segment.accepted	= false;
+		segment.finished	= false;
+		segment.waiting		= false;
+
+		QObject::connect(reply, &QNetworkReply::metaDataChanged, [transfer, index, generation] (void) {
+			if (transfer->done == false && transfer->generation == generation && transfer->segments[index].accepted == false)
+			{
+				Accept(transfer, index);
+			}
+		});
+		QObject::connect(reply, &QNetworkReply::readyRead, [transfer, index, generation] (void) {
+			if (transfer->done == false && transfer->generation == generation)
+			{
+				const Segment & segment = transfer->segments[index];
+				if (segment.accepted == true && segment.waiting == false)
+				{
+					Pump(transfer, index, generation);
+				}
+			}
+		});
+		QObject::connect(reply, &QNetworkReply::finished, [transfer, index, generation, reply] (void) {
+			if (transfer->done == true || transfer->generation != generation)
+			{
+				reply->deleteLater();
+				return;
+			}
+			Segment & segment = transfer->segments[index];
+			segment.finished = true;
+			if (segment.accepted == false || reply->error() != QNetworkReply::NoError)
+			{
+				FinishSegment(transfer, index);
+			}
+			else if (segment.waiting == false)
+			{
+				Pump(transfer, index, generation);
+			}
+		});
+	}
+
+	//!
+	//! Send the requests of the segments that are not complete yet.
+	//!
+	static void StartSegments(const std::shared_ptr< Transfer > & transfer)
+	{
+		const int generation = transfer->generation;
+		bool complete = true;
+		for (size_t i = 0; i < transfer->segments.size() && transfer->generation == generation; ++i)
+		{
+			if (transfer->segments[i].complete == false)
+			{
+				complete = false;
+				StartSegment(transfer, i);
+			}
+		}
+		if (complete == true)
+		{
+			Complete(transfer);
+		}
+	}
+
+	//!
+	//! Check if the server supports ranges and get the size of the file, to split it into
+	//! segments.
+	//!
+	static void Probe(const std::shared_ptr< Transfer > & transfer)
+	{
+		const int generation = transfer->generation;
+		QNetworkReply * reply = transfer->networkManager->head(CreateRequest(*transfer));
+		transfer->segments.push_back(Segment());
+		transfer->segments.back().reply = reply;
+
+		QObject::connect(reply, &QNetworkReply::finished, [transfer, generation, reply] (void) {
+			reply->deleteLater();
+			if (transfer->done == true || transfer->generation != generation)
+			{
+				return;
+			}
+			transfer->segments.clear();
+
+			const QVariant length = reply->header(QNetworkRequest::ContentLengthHeader);
+			const qint64 size = length.isValid() == true ? length.toLongLong() : -1;
+			const bool ranges = reply->error() == QNetworkReply::NoError && reply->rawHeader("Accept-Ranges").trimmed() == "bytes";
+			const qint64 count = ranges == true && size > 0 ? qBound(qint64(1), size / qMax(qint64(1), transfer->options.minSegmentSize), qint64(transfer->options.segments)) : 1;
+			if (count == 1)
+			{
+				// a single plain request, which will also report the errors, if any
+				transfer->segments.push_back(Segment());
+			}
+			else
+			{
+				transfer->validator = GetValidator(reply);
+				transfer->size = size;
+				for (qint64 i = 0; i < count; ++i)
+				{
+					Segment segment;
+					segment.start	= size * i / count;
+					segment.end		= size * (i + 1) / count - 1;
+					transfer->segments.push_back(segment);
+				}
+			}
+			StartSegments(transfer);
+		});
+	}
+
+	//!
+	//! Start or resume a download.
+	//!
+	static void Start(const std::shared_ptr< Transfer > & transfer)
+	{
+		if (LoadState(*transfer) == true)
+		{
+			StartSegments(transfer);
+			return;
+		}
+
+		// without its progress (or a way to check it), a partial file is useless
+		QFile::remove(GetPartFilename(*transfer));
+		if (transfer->options.segments > 1)
+		{
+			Probe(transfer);
+		}
+		else
+		{
+			transfer->segments.push_back(Segment());
+			StartSegments(transfer);
+		}
+	}
+
+	//!
+	//! Call @p function from the thread of @p transfer's network manager.
+	//!
+	static void RunInThread(const std::shared_ptr< Transfer > & transfer, const std::function< void (void) > & function)
+	{
+		if (transfer->networkManager->thread() == QThread::currentThread())
+		{
+			function();
+		}
+		else
+		{
+			QMetaObject::invokeMethod(transfer->networkManager, function, Qt::QueuedConnection);
+		}
+	}
+
+	//!
+	//! Get a running download.
+	//!
+	static std::shared_ptr< Transfer > GetTransfer(int id)
+	{
+		DownloadData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		return data.transfers.value(id);
+	}
+
+	//!
+	//! Set the global bandwidth cap, shared by all the downloads, in bytes per second.
+	//! 0 (the default) means no cap.
+	//!
+	void DownloadManager::SetBandwidth(qint64 bytesPerSecond)
+	{
+		DownloadData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		data.bucket.SetRate(bytesPerSecond);
+	}
+
+	//!
+	//! Get the global bandwidth cap.
+	//!
+	qint64 DownloadManager::GetBandwidth(void)
+	{
+		DownloadData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		return data.bucket.rate;
+	}
+
+	//!
+	//! Download a url into a file, resuming a previous download of the same url to the
+	//! same file if possible.
+	//!
+	//! @param url
+	//!		The url to download.
+	//!
+	//! @param filename
+	//!		The destination file. It's only replaced once the download is complete.
+	//!
+	//! @param success
+	//!		Called when the download is complete, with the size of the file.
+	//!
+	//! @param failure
+	//!		Called if the download failed or was stopped. What was downloaded is kept, and
+	//!		the next download of the same url to the same file resumes from there.
+	//!
+	//! @returns
+	//!		The id of the download, which can be used to stop it or change its bandwidth.
+	//!
+	int DownloadManager::Download(const QString & url, const QString & filename, const CompletionCallback & success, const FailureCallback & failure, const Options & options)
+	{
+		auto transfer = std::make_shared< Transfer >();
+		transfer->url				= QUrl(url);
+		transfer->filename			= filename;
+		transfer->options			= options;
+		transfer->success			= success;
+		transfer->failure			= failure;
+		transfer->networkManager	= options.networkManager != nullptr ? options.networkManager : GetNetworkManager(transfer->url);
+		transfer->bucket.SetRate(options.bandwidth);
+
+		{
+			DownloadData & data = GetData();
+			QMutexLocker lock(&data.mutex);
+			transfer->id = data.nextId++;
+			data.transfers.insert(transfer->id, transfer);
+		}
+
+		RunInThread(transfer, [transfer] (void) { Start(transfer); });
+		return transfer->id;
+	}
+
+	//!
+	//! Change the bandwidth cap of a download. Returns false if the download is not running.
+	//!
+	bool DownloadManager::SetBandwidth(int id, qint64 bytesPerSecond)
+	{
+		std::shared_ptr< Transfer > transfer = GetTransfer(id);
+		if (transfer == nullptr)
+		{
+			return false;
+		}
+		RunInThread(transfer, [transfer, bytesPerSecond] (void) { transfer->bucket.SetRate(bytesPerSecond); });
+		return true;
+	}
+
+	//!
+	//! Stop a download, keeping what was downloaded so far. Its failure callback is called
+	//! with an OperationCanceledError. Returns false if the download is not running.
+	//!
+	bool DownloadManager::Stop(int id)
+	{
+		std::shared_ptr< Transfer > transfer = GetTransfer(id);
+		if (transfer == nullptr)
+		{
+			return false;
+		}
+		RunInThread(transfer, [transfer] (void) {
+			Fail(transfer, QNetworkReply::OperationCanceledError, "Download stopped");
+		});
+		return true;
+	}
+
+QT_UTILS_NAMESPACE_END
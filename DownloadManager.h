@@ -0,0 +1,76 @@
+#ifndef QT_UTILS_DOWNLOAD_MANAGER_H
+#define QT_UTILS_DOWNLOAD_MANAGER_H
+
+#include "./HttpRequest.h"
+
+
+QT_UTILS_NAMESPACE_BEGIN
+
+	//!
+	//! Resumable downloads of big files, on top of the HttpRequest network threads.
+	//!
+	//! The data is written to `<filename>.part`, and the progress is saved next to it in
+	//! `<filename>.part.json`. When a download is interrupted (failure, stop, or even a crash)
+	//! the next download of the same url to the same file resumes from there, using a Range
+	//! request guarded by If-Range so that a file that changed on the server is downloaded
+	//! again from the start. Files without an ETag nor a Last-Modified date can't be checked
+	//! that way, and are always downloaded again from the start. The final file is only
+	//! created once the download is complete.
+	//!
+	//! For servers supporting ranges, a download can also be split into segments that are
+	//! downloaded in parallel. And the bandwidth can be capped, globally and per download,
+	//! so that background downloads don't starve the interactive requests:
+	//!
+	//! ```.cpp
+	//! DownloadManager::SetBandwidth(2 * 1024 * 1024);
+	//!
+	//! DownloadManager::Options options;
+	//! options.segments = 4;
+	//! int id = DownloadManager::Download("https://some_url/big.bin", "big.bin", success, failure, options);
+	//!
+	//! // later, e.g. when the application quits. It will be resumed by the next Download call
+	//! DownloadManager::Stop(id);
+	//! ```
+	//!
+	//! All callbacks are called from the network thread of the download.
+	//!
+	class DownloadManager
+	{
+
+	public:
+
+		//!
+		//! Options of a download.
+		//!
+		struct Options
+		{
+			//! Network manager to use. If nullptr, the pooled network manager of the host is used.
+			QNetworkAccessManager * networkManager = nullptr;
+
+			//! Maximum number of segments downloaded in parallel, if the server supports ranges
+			int segments = 1;
+
+			//! Minimum size of a segment, in bytes
+			qint64 minSegmentSize = 4 * 1024 * 1024;
+
+			//! Bandwidth cap of the download in bytes per second, or 0 for no cap
+			qint64 bandwidth = 0;
+
+			//! Optional callback reporting the number of bytes downloaded so far, and the total
+			//! size (or -1 if it's not known yet)
+			ProgressCallback progress;
+		};
+
+		// C++ API
+		static void		SetBandwidth(qint64 bytesPerSecond);
+		static qint64	GetBandwidth(void);
+		static int		Download(const QString & url, const QString & filename, const CompletionCallback & success, const FailureCallback & failure, const Options & options = Options());
+		static bool		SetBandwidth(int id, qint64 bytesPerSecond);
+		static bool		Stop(int id);
+
+	};
+
+QT_UTILS_NAMESPACE_END
+
+
+#endif
@@ -1,33 +1,1432 @@
 #include "./File.h"
+#include "./Job.h"
+
+#include <QDataStream>
+#include <QDirIterator>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QFileInfo>
+#include <QJSEngine>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <cstring>
+#include <limits>
+
+
+QT_UTILS_NAMESPACE_BEGIN
+
+	//!
+	//! The mapping of a file.
+	//!
+	struct MappedFile::Data
+	{
+		//! The mapped file. Closing it releases the mapping
+		QFile file;
+
+		//! The mapped data
+		const char * data = nullptr;
+
+		//! Size of the mapped data
+		qint64 size = 0;
+	};
+
+	//!
+	//! Default constructor: an invalid mapping.
+	//!
+	MappedFile::MappedFile(void)
+	{
+	}
+
+	//!
+	//! Map @p filename. Check IsValid to know if it worked: mapping fails for empty files,
+	//! files that can't be opened, or special files (pipes, sockets, etc.)
+	//!
+	MappedFile::MappedFile(const QString & filename)
+	{
+		auto data = std::make_shared< Data >();
+		data->file.setFileName(filename);
+		if (data->file.open(QIODevice::ReadOnly) == false)
+		{
+			return;
+		}
+		data->size = data->file.size();
+		data->data = data->size > 0 ? reinterpret_cast< const char * >(data->file.map(0, data->size)) : nullptr;
+		if (data->data != nullptr)
+		{
+			m_Data = data;
+		}
+	}
+
+	//!
+	//! Returns true if the file was successfully mapped.
+	//!
+	bool MappedFile::IsValid(void) const
+	{
+		return m_Data != nullptr;
+	}
+
+	//!
+	//! Get the size of the mapped data, in bytes.
+	//!
+	qint64 MappedFile::GetSize(void) const
+	{
+		return m_Data != nullptr ? m_Data->size : 0;
+	}
+
+	//!
+	//! Get a pointer to the mapped data, or nullptr if the mapping is invalid.
+	//!
+	const char * MappedFile::GetData(void) const
+	{
+		return m_Data != nullptr ? m_Data->data : nullptr;
+	}
+
+	//!
+	//! Get a view of the mapped data, without any copy. Modifying the returned array
+	//! detaches it (copies the data) as usual.
+	//!
+	//! @note
+	//!		QByteArray can't hold more than 2GB: for bigger files, an empty array is
+	//!		returned, and GetData must be used instead.
+	//!
+	QByteArray MappedFile::GetBytes(void) const
+	{
+		if (m_Data == nullptr || m_Data->size > std::numeric_limits< int >::max())
+		{
+			return QByteArray();
+		}
+		return QByteArray::fromRawData(m_Data->data, static_cast< int >(m_Data->size));
+	}
+
+	//!
+	//! Decode the mapped data from UTF-8. This is the only copy made by a mapped read.
+	//! See DecodeUtf8 for @p mode and @p errorOffset.
+	//!
+	QString MappedFile::ToString(Utf8Mode mode, qint64 * errorOffset) const
+	{
+		if (m_Data == nullptr)
+		{
+			if (errorOffset != nullptr)
+			{
+				*errorOffset = -1;
+			}
+			return QString();
+		}
+		return DecodeUtf8(m_Data->data, m_Data->size, mode, errorOffset);
+	}
+
+	//!
+	//! Number of files hashed by each job of a scan.
+	//!
+	static const int s_HashBatchSize = 64;
+
+	//!
+	//! Magic number and version of the hash cache files.
+	//!
+	static const quint32 s_HashCacheMagic = 0x51554843;
+	static const quint32 s_HashCacheVersion = 1;
+
+	//!
+	//! Constants of XXH64.
+	//!
+	static const quint64 s_Prime1 = 11400714785074694791ULL;
+	static const quint64 s_Prime2 = 14029467366897019727ULL;
+	static const quint64 s_Prime3 = 1609587929392839161ULL;
+	static const quint64 s_Prime4 = 9650029242287828579ULL;
+	static const quint64 s_Prime5 = 2870177450012600261ULL;
+
+	//!
+	//! Rotate left.
+	//!
+	static inline quint64 RotateLeft(quint64 value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	//!
+	//! Read a little endian 64 bits value.
+	//!
+	static inline quint64 Read64(const uchar * data)
+	{
+		quint64 value;
+		memcpy(&value, data, sizeof(value));
+		return qFromLittleEndian(value);
+	}
+
+	//!
+	//! Read a little endian 32 bits value.
+	//!
+	static inline quint32 Read32(const uchar * data)
+	{
+		quint32 value;
+		memcpy(&value, data, sizeof(value));
+		return qFromLittleEndian(value);
+	}
+
+	//!
+	//! Mix 8 bytes of input into an accumulator.
+	//!
+	static inline quint64 Round(quint64 accumulator, quint64 input)
+	{
+		accumulator += input * s_Prime2;
+		accumulator = RotateLeft(accumulator, 31);
+		return accumulator * s_Prime1;
+	}
+
+	//!
+	//! Merge an accumulator into the hash.
+	//!
+	static inline quint64 Merge(quint64 hash, quint64 accumulator)
+	{
+		hash ^= Round(0, accumulator);
+		return hash * s_Prime1 + s_Prime4;
+	}
+
+	//!
+	//! XXH64, a fast non-cryptographic hash (https://github.com/Cyan4973/xxHash)
+	//!
+	static quint64 XXHash64(const char * input, qint64 size, quint64 seed = 0)
+	{
+		const uchar * data = reinterpret_cast< const uchar * >(input);
+		const uchar * end = data + size;
+		quint64 hash;
+
+		if (size >= 32)
+		{
+			quint64 v1 = seed + s_Prime1 + s_Prime2;
+			quint64 v2 = seed + s_Prime2;
+			quint64 v3 = seed;
+			quint64 v4 = seed - s_Prime1;
+			for (const uchar * limit = end - 32; data <= limit; data += 32)
+			{
+				v1 = Round(v1, Read64(data));
+				v2 = Round(v2, Read64(data + 8));
+				v3 = Round(v3, Read64(data + 16));
+				v4 = Round(v4, Read64(data + 24));
+			}
+			hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+			hash = Merge(hash, v1);
+			hash = Merge(hash, v2);
+			hash = Merge(hash, v3);
+			hash = Merge(hash, v4);
+		}
+		else
+		{
+			hash = seed + s_Prime5;
+		}
+
+		hash += static_cast< quint64 >(size);
+		for (; data + 8 <= end; data += 8)
+		{
+			hash ^= Round(0, Read64(data));
+			hash = RotateLeft(hash, 27) * s_Prime1 + s_Prime4;
+		}
+		if (data + 4 <= end)
+		{
+			hash ^= static_cast< quint64 >(Read32(data)) * s_Prime1;
+			hash = RotateLeft(hash, 23) * s_Prime2 + s_Prime3;
+			data += 4;
+		}
+		for (; data < end; ++data)
+		{
+			hash ^= *data * s_Prime5;
+			hash = RotateLeft(hash, 11) * s_Prime1;
+		}
+
+		// avalanche
+		hash ^= hash >> 33;
+		hash *= s_Prime2;
+		hash ^= hash >> 29;
+		hash *= s_Prime3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
+	//!
+	//! Hash the content of a file, reading it through a mapping when possible.
+	//!
+	static bool HashFile(const QString & path, quint64 & hash)
+	{
+		const MappedFile mapped(path);
+		if (mapped.IsValid() == true)
+		{
+			hash = XXHash64(mapped.GetData(), mapped.GetSize());
+			return true;
+		}
+
+		// empty or special file
+		QFile file(path);
+		if (file.open(QIODevice::ReadOnly) == false)
+		{
+			return false;
+		}
+		const QByteArray data = file.readAll();
+		hash = XXHash64(data.constData(), data.size());
+		return true;
+	}
+
+	//!
+	//! The state of a hashing operation.
+	//!
+	struct File::HashState
+	{
+		//! The File instance receiving the results. Only used from its thread
+		File * file = nullptr;
+
+		//! Posts the results to the thread of the File instance, unless it's destroyed
+		std::shared_ptr< Delivery > delivery;
+
+		//! Id of the operation
+		int id = 0;
+
+		//! Set when the operation is cancelled
+		std::shared_ptr< std::atomic< bool > > cancelled = std::make_shared< std::atomic< bool > >(false);
+
+		//! Number of running jobs. The operation is finished when it drops to 0
+		std::atomic< int > pending{ 1 };
+
+		//! The cache file, if any
+		QString cacheFile;
+
+		//! Protects the cache
+		QMutex mutex;
+
+		//! Known hashes, by absolute path
+		QHash< QString, FileHash > cache;
+
+		//! True when new hashes were added to the cache
+		bool dirty = false;
+
+		//!
+		//! Load the cache file.
+		//!
+		void Load(void)
+		{
+			QFile file(cacheFile);
+			if (cacheFile.isEmpty() == true || file.open(QIODevice::ReadOnly) == false)
+			{
+				return;
+			}
+
+			QDataStream stream(&file);
+			stream.setVersion(QDataStream::Qt_5_0);
+			quint32 magic = 0, version = 0;
+			stream >> magic >> version;
+			if (magic != s_HashCacheMagic || version != s_HashCacheVersion)
+			{
+				return;
+			}
+
+			QMutexLocker lock(&mutex);
+			while (stream.atEnd() == false)
+			{
+				FileHash entry;
+				qint64 modified = 0;
+				stream >> entry.path >> entry.size >> modified >> entry.hash;
+				if (stream.status() != QDataStream::Ok)
+				{
+					break;
+				}
+				entry.modified = QDateTime::fromMSecsSinceEpoch(modified);
+				cache.insert(entry.path, entry);
+			}
+		}
+
+		//!
+		//! Save the cache file, if it changed.
+		//!
+		void Save(void)
+		{
+			QMutexLocker lock(&mutex);
+			if (cacheFile.isEmpty() == true || dirty == false)
+			{
+				return;
+			}
+
+			QSaveFile file(cacheFile);
+			if (file.open(QIODevice::WriteOnly) == false)
+			{
+				return;
+			}
+			QDataStream stream(&file);
+			stream.setVersion(QDataStream::Qt_5_0);
+			stream << s_HashCacheMagic << s_HashCacheVersion;
+			for (const FileHash & entry : cache)
+			{
+				stream << entry.path << entry.size << entry.modified.toMSecsSinceEpoch() << entry.hash;
+			}
+			file.commit();
+		}
+	};
+
+	//!
+	//! Read a file. The file is mapped and directly decoded from the mapping, instead of
+	//! being read in a temporary buffer. @p ok is set to false if it couldn't be read, or
+	//! if it's not valid UTF-8 in strict mode.
+	//!
+	static QString ReadFile(const QString & filename, bool & ok, Utf8Mode mode = Utf8Mode::Replace, qint64 * errorOffset = nullptr)
+	{
+		qint64 error = -1;
+		QString content;
+		const MappedFile mapped(filename);
+		if (mapped.IsValid() == true)
+		{
+			ok = true;
+			content = mapped.ToString(mode, &error);
+		}
+		else
+		{
+			// empty or special file
+			QFile file(filename);
+			ok = file.open(QIODevice::ReadOnly);
+			if (ok == true)
+			{
+				content = DecodeUtf8(file.readAll(), mode, &error);
+			}
+		}
+
+		if (errorOffset != nullptr)
+		{
+			*errorOffset = error;
+		}
+		if (mode == Utf8Mode::Strict && error != -1)
+		{
+			ok = false;
+		}
+		return content;
+	}
+
+	//!
+	//! Write @p content to @p device in UTF-8. The content is encoded by chunks, so that a
+	//! big string is never entirely duplicated in memory.
+	//!
+	static bool WriteUtf8(QIODevice & device, const QString & content)
+	{
+		const int chunkSize = 1024 * 1024;
+		for (int offset = 0; offset < content.size();)
+		{
+			// don't split surrogate pairs
+			int size = qMin(chunkSize, content.size() - offset);
+			if (offset + size < content.size() && content.at(offset + size - 1).isHighSurrogate() == true)
+			{
+				--size;
+			}
+
+			const QByteArray chunk = EncodeUtf8(content.constData() + offset, size);
+			if (device.write(chunk) != chunk.size())
+			{
+				return false;
+			}
+			offset += size;
+		}
+		return true;
+	}
+
+	//!
+	//! Open @p filename for writing according to @p mode, and write to it using @p write.
+	//!
+	static bool WriteFile(const QString & filename, File::WriteMode mode, const std::function< bool (QIODevice &) > & write)
+	{
+		if (mode == File::Atomic)
+		{
+			// if the file can't be replaced (e.g. no write access to its folder) it's written in place
+			QSaveFile file(filename);
+			file.setDirectWriteFallback(true);
+			return file.open(QIODevice::WriteOnly) == true && write(file) == true && file.commit() == true;
+		}
+
+		QFile file(filename);
+		const QIODevice::OpenMode openMode = mode == File::Append ? QIODevice::Append : QIODevice::WriteOnly | QIODevice::Truncate;
+		return file.open(openMode) == true && write(file) == true && file.flush() == true;
+	}
+
+	//!
+	//! Write a string in a file, encoded in UTF-8. It returns true if the whole content was
+	//! written.
+	//!
+	bool File::Write(const QString & filename, const QString & content, WriteMode mode)
+	{
+		return WriteFile(filename, mode, [&content] (QIODevice & device) {
+			return WriteUtf8(device, content);
+		});
+	}
+
+	//!
+	//! Write raw data in a file. It returns true if the whole content was written.
+	//!
+	bool File::Write(const QString & filename, const QByteArray & content, WriteMode mode)
+	{
+		return WriteFile(filename, mode, [&content] (QIODevice & device) {
+			return device.write(content) == content.size();
+		});
+	}
+
+	//!
+	//! Constructor.
+	//!
+	File::File(QObject * parent)
+		: QObject(parent)
+		, m_Cache(0)
+	{
+	}
+
+	//!
+	//! Get the maximum memory used by the content cache, in bytes. 0 means the cache is
+	//! disabled, which is the default.
+	//!
+	int File::GetCacheSize(void) const
+	{
+		return m_Cache.maxCost();
+	}
+
+	//!
+	//! Set the maximum memory used by the content cache, in bytes. When it's full, the least
+	//! recently read files are evicted first. 0 disables the cache.
+	//!
+	void File::SetCacheSize(int cacheSize)
+	{
+		cacheSize = qMax(0, cacheSize);
+		if (m_Cache.maxCost() != cacheSize)
+		{
+			m_Cache.setMaxCost(cacheSize);
+			PruneWatcher();
+			emit cacheSizeChanged(cacheSize);
+		}
+	}
+
+	//!
+	//! Get the statistics of the content cache.
+	//!
+	File::CacheStats File::GetCacheStats(void) const
+	{
+		CacheStats stats;
+		stats.hits		= m_CacheHits;
+		stats.misses	= m_CacheMisses;
+		stats.entries	= m_Cache.count();
+		stats.memory	= m_Cache.totalCost();
+		return stats;
+	}
+
+	//!
+	//! Remove all the files from the content cache, and reset its statistics.
+	//!
+	void File::ClearCache(void)
+	{
+		m_Cache.clear();
+		m_CacheHits = 0;
+		m_CacheMisses = 0;
+		PruneWatcher();
+	}
+
+	//!
+	//! Remove a file from the content cache, and stop watching it.
+	//!
+	void File::Invalidate(const QString & filename)
+	{
+		const QString path = QFileInfo(filename).absoluteFilePath();
+		m_Cache.remove(path);
+		if (m_Watcher != nullptr && m_Watcher->files().contains(path) == true)
+		{
+			m_Watcher->removePath(path);
+		}
+	}
+
+	//!
+	//! Stop watching the files which were evicted from the content cache.
+	//!
+	void File::PruneWatcher(void)
+	{
+		if (m_Watcher == nullptr)
+		{
+			return;
+		}
+		for (const QString & path : m_Watcher->files())
+		{
+			if (m_Cache.contains(path) == false)
+			{
+				m_Watcher->removePath(path);
+			}
+		}
+	}
+
+	//!
+	//! Called when a cached file changed on disk.
+	//!
+	void File::OnFileChanged(const QString & path)
+	{
+		Invalidate(path);
+		emit fileChanged(path);
+	}
+
+	//!
+	//! Read an entier file and return its content as a string.
+	//!
+	QString File::read(const QString & filename)
+	{
+		bool ok = false;
+		if (m_Cache.maxCost() <= 0)
+		{
+			return ReadFile(filename, ok);
+		}
+
+		// a cached content is only used if the file still has the same size and modification time
+		const QFileInfo info(filename);
+		const QString path = info.absoluteFilePath();
+		const QDateTime modified = info.lastModified();
+		const qint64 size = info.size();
+		const CacheEntry * entry = m_Cache.object(path);
+		if (entry != nullptr && entry->modified == modified && entry->size == size)
+		{
+			++m_CacheHits;
+			return entry->content;
+		}
+		++m_CacheMisses;
+
+		// files bigger than the whole cache are not cached
+		const QString content = ReadFile(filename, ok);
+		const qint64 cost = static_cast< qint64 >(content.size()) * static_cast< qint64 >(sizeof(QChar));
+		if (ok == false || info.exists() == false || cost > m_Cache.maxCost())
+		{
+			Invalidate(path);
+			return content;
+		}
+
+		m_Cache.insert(path, new CacheEntry{ content, modified, size }, static_cast< int >(cost));
+		if (m_Watcher == nullptr)
+		{
+			m_Watcher = new QFileSystemWatcher(this);
+			QObject::connect(m_Watcher, &QFileSystemWatcher::fileChanged, this, &File::OnFileChanged);
+		}
+		if (m_Watcher->files().contains(path) == false)
+		{
+			m_Watcher->addPath(path);
+		}
+		PruneWatcher();
+		return content;
+	}
+
+	//!
+	//! Read a file and decode it from UTF-8. @p ok (optional) is set to false if the file
+	//! couldn't be read, or in strict mode if it's not valid UTF-8, in which case the offset
+	//! of the first invalid byte is stored in @p errorOffset (optional)
+	//!
+	QString File::Read(const QString & filename, Utf8Mode mode, bool * ok, qint64 * errorOffset)
+	{
+		bool result = false;
+		const QString content = ReadFile(filename, result, mode, errorOffset);
+		if (ok != nullptr)
+		{
+			*ok = result;
+		}
+		return content;
+	}
+
+	//!
+	//! Read a file which must be valid UTF-8. Returns an object with the `content`, `ok`
+	//! and `errorOffset` properties. `errorOffset` is the offset of the first invalid byte,
+	//! or -1 if the content is valid.
+	//!
+	QVariantMap File::readStrict(const QString & filename)
+	{
+		bool ok = false;
+		qint64 errorOffset = -1;
+		const QString content = Read(filename, Utf8Mode::Strict, &ok, &errorOffset);
+		return {
+			{ "content",		content },
+			{ "ok",				ok },
+			{ "errorOffset",	static_cast< double >(errorOffset) },
+		};
+	}
+
+	//!
+	//! Writes a string into a file. Unless @p mode is Append, this will overwrites any
+	//! previous content, if @p filename already exists. It returns true if the operation
+	//! succeeded.
+	//!
+	bool File::write(const QString & filename, const QString & content, WriteMode mode)
+	{
+		Invalidate(filename);
+		return Write(filename, content, mode);
+	}
 
+	//!
+	//! Start an asynchronous operation.
+	//!
+	//! @param callback
+	//!		QML function called with the result of the operation, from the thread of this
+	//!		instance. It can be undefined.
+	//!
+	//! @param operation
+	//!		The operation, run on a Job worker. It returns the arguments of the callback.
+	//!
+	//! @returns
+	//!		The id of the operation.
+	//!
+	int File::Start(const QJSValue & callback, const std::function< QVariantList (void) > & operation)
+	{
+		const int id = m_NextId++;
+		auto cancelled = std::make_shared< std::atomic< bool > >(false);
+		m_Operations.insert(id, { callback, HashCallback(), cancelled });
+
+		// back to the thread of this instance to call the callback, unless it was destroyed
+		auto delivery = Delivery::Create(this);
+		new Job([this, delivery, id, cancelled, operation] (void) {
+			if (*cancelled == true)
+			{
+				return;
+			}
+			const QVariantList result = operation();
+			if (*cancelled == true)
+			{
+				return;
+			}
+			delivery->Post([this, id, result] (void) {
+				// cancelled operations are already removed
+				const Operation operation = m_Operations.take(id);
+				if (operation.cancelled == nullptr || operation.callback.isCallable() == false)
+				{
+					return;
+				}
+				QJSValueList arguments;
+				for (const QVariant & value : result)
+				{
+					arguments << (value.type() == QVariant::Bool ? QJSValue(value.toBool()) : QJSValue(value.toString()));
+				}
+				operation.callback.call(arguments);
+			});
+		}, "File");
+		return id;
+	}
+
+	//!
+	//! Asynchronously read a file. The file is read on a Job worker, and @p callback is then
+	//! called from the thread of this instance with the content of the file and a boolean
+	//! set to false if it couldn't be read.
+	//!
+	//! @returns
+	//!		The id of the operation, which can be used to cancel it.
+	//!
+	int File::readAsync(const QString & filename, const QJSValue & callback)
+	{
+		return Start(callback, [filename] (void) {
+			bool ok = false;
+			const QString content = ReadFile(filename, ok);
+			return QVariantList{ content, ok };
+		});
+	}
+
+	//!
+	//! Asynchronously write a file. The file is written on a Job worker, and @p callback
+	//! (optional) is then called from the thread of this instance with a boolean telling if
+	//! the write succeeded.
+	//!
+	//! @returns
+	//!		The id of the operation, which can be used to cancel it.
+	//!
+	int File::writeAsync(const QString & filename, const QString & content, const QJSValue & callback, WriteMode mode)
+	{
+		Invalidate(filename);
+		return Start(callback, [filename, content, mode] (void) {
+			return QVariantList{ Write(filename, content, mode) };
+		});
+	}
 
-//!
-//! Read an entier file and return its content as a string.
-//!
-QString File::read(const QString & filename)
-{
-	QFile file(filename);
-	if (file.open(QIODevice::ReadOnly) == false)
+	//!
+	//! Cancel a pending asynchronous operation: if it hasn't started yet it won't be, and
+	//! in any case its callback won't be called. Returns false if the operation is already
+	//! finished.
+	//!
+	bool File::cancel(int id)
 	{
-		return QString();
+		auto operation = m_Operations.find(id);
+		if (operation == m_Operations.end())
+		{
+			return false;
+		}
+		*operation->cancelled = true;
+		m_Operations.erase(operation);
+		return true;
 	}
 
-	return file.readAll();
-}
+	//!
+	//! Get the statistics of the content cache, as an object with the `hits`, `misses`,
+	//! `hitRate`, `entries` and `memory` (in bytes) properties.
+	//!
+	QVariantMap File::cacheStats(void) const
+	{
+		const CacheStats stats = GetCacheStats();
+		const qint64 reads = stats.hits + stats.misses;
+		return {
+			{ "hits",		stats.hits },
+			{ "misses",		stats.misses },
+			{ "hitRate",	reads > 0 ? static_cast< double >(stats.hits) / reads : 0.0 },
+			{ "entries",	stats.entries },
+			{ "memory",		stats.memory },
+		};
+	}
+
+	//!
+	//! Clear the content cache.
+	//!
+	void File::clearCache(void)
+	{
+		ClearCache();
+	}
+
+	//!
+	//! Recursively scan @p root for files matching @p filters (e.g. `*.jpg`, all files if
+	//! empty) and hash them in parallel on the Job pool. @p callback is called from the thread
+	//! of this instance with batches of results.
+	//!
+	//! @param cacheFile
+	//!		Optional file where the hashes are kept between scans. Files whose size and
+	//!		modification time are unchanged are not read again.
+	//!
+	//! @returns
+	//!		The id of the operation, which can be used to cancel it.
+	//!
+	int File::Scan(const QString & root, const QStringList & filters, const HashCallback & callback, const QString & cacheFile)
+	{
+		return StartHashing(callback, cacheFile, [root, filters] (const std::shared_ptr< HashState > & state) {
+			QStringList batch;
+			QDirIterator iterator(root, filters, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+			while (iterator.hasNext() == true && *state->cancelled == false)
+			{
+				batch.push_back(iterator.next());
+				if (batch.size() == s_HashBatchSize)
+				{
+					HashBatch(state, batch);
+					batch.clear();
+				}
+			}
+			if (batch.isEmpty() == false)
+			{
+				HashBatch(state, batch);
+			}
+		});
+	}
+
+	//!
+	//! Hash the given files in parallel on the Job pool. Works like Scan.
+	//!
+	int File::HashFiles(const QStringList & paths, const HashCallback & callback, const QString & cacheFile)
+	{
+		return StartHashing(callback, cacheFile, [paths] (const std::shared_ptr< HashState > & state) {
+			for (int i = 0; i < paths.size() && *state->cancelled == false; i += s_HashBatchSize)
+			{
+				HashBatch(state, paths.mid(i, s_HashBatchSize));
+			}
+		});
+	}
+
+	//!
+	//! Start a hashing operation.
+	//!
+	//! @param enumerate
+	//!		Function run on a Job worker, which calls HashBatch with the files to hash.
+	//!
+	int File::StartHashing(const HashCallback & callback, const QString & cacheFile, const std::function< void (const std::shared_ptr< HashState > & state) > & enumerate)
+	{
+		auto state = std::make_shared< HashState >();
+		state->file = this;
+		state->delivery = Delivery::Create(this);
+		state->id = m_NextId++;
+		state->cacheFile = cacheFile;
+		m_Operations.insert(state->id, { QJSValue(), callback, state->cancelled });
+
+		new Job([state, enumerate] (void) {
+			state->Load();
+			enumerate(state);
+			ReleaseHashing(state);
+		}, "File::Scan");
+		return state->id;
+	}
+
+	//!
+	//! Hash a batch of files on a Job worker, and post the results.
+	//!
+	void File::HashBatch(const std::shared_ptr< HashState > & state, const QStringList & paths)
+	{
+		++state->pending;
+		new Job([state, paths] (void) {
+			QVector< FileHash > files;
+			files.reserve(paths.size());
+			for (const QString & path : paths)
+			{
+				if (*state->cancelled == true)
+				{
+					break;
+				}
+
+				const QFileInfo info(path);
+				if (info.isFile() == false)
+				{
+					continue;
+				}
+				FileHash file;
+				file.path		= info.absoluteFilePath();
+				file.size		= info.size();
+				file.modified	= info.lastModified();
+
+				// reuse the hash of unchanged files
+				bool cached = false;
+				{
+					QMutexLocker lock(&state->mutex);
+					const auto entry = state->cache.constFind(file.path);
+					if (entry != state->cache.constEnd() && entry->size == file.size && entry->modified == file.modified)
+					{
+						file.hash = entry->hash;
+						cached = true;
+					}
+				}
+				if (cached == false)
+				{
+					if (HashFile(file.path, file.hash) == false)
+					{
+						continue;
+					}
+					QMutexLocker lock(&state->mutex);
+					state->cache.insert(file.path, file);
+					state->dirty = true;
+				}
+				files.push_back(file);
+			}
+
+			if (files.isEmpty() == false)
+			{
+				PostHashes(state, files, false);
+			}
+			ReleaseHashing(state);
+		}, "File::HashBatch");
+	}
+
+	//!
+	//! Called when a job of a hashing operation is done. The last one saves the cache, even
+	//! if the operation was cancelled, so that the next scan doesn't start from scratch.
+	//!
+	void File::ReleaseHashing(const std::shared_ptr< HashState > & state)
+	{
+		if (--state->pending == 0)
+		{
+			state->Save();
+			PostHashes(state, {}, true);
+		}
+	}
+
+	//!
+	//! Post results to the thread of the File instance.
+	//!
+	void File::PostHashes(const std::shared_ptr< HashState > & state, const QVector< FileHash > & files, bool finished)
+	{
+		if (*state->cancelled == true)
+		{
+			return;
+		}
+		state->delivery->Post([file = state->file, id = state->id, files, finished] (void) {
+			file->DeliverHashes(id, files, finished);
+		});
+	}
+
+	//!
+	//! Call the callback of a hashing operation, unless it was cancelled.
+	//!
+	void File::DeliverHashes(int id, const QVector< FileHash > & files, bool finished)
+	{
+		auto operation = m_Operations.find(id);
+		if (operation == m_Operations.end())
+		{
+			return;
+		}
+		const HashCallback callback = operation->hashCallback;
+		if (finished == true)
+		{
+			m_Operations.erase(operation);
+		}
+		if (callback)
+		{
+			callback(files, finished);
+		}
+	}
+
+	//!
+	//! Convert hashed files to a list of objects usable from QML. The hashes are converted
+	//! to hexadecimal strings since JavaScript numbers can't hold 64 bits integers.
+	//!
+	QVariantList File::ToVariant(const QVector< FileHash > & files)
+	{
+		QVariantList result;
+		result.reserve(files.size());
+		for (const FileHash & file : files)
+		{
+			result.push_back(QVariantMap{
+				{ "path",		file.path },
+				{ "size",		static_cast< double >(file.size) },
+				{ "modified",	file.modified },
+				{ "hash",		QString::number(file.hash, 16).rightJustified(16, '0') },
+			});
+		}
+		return result;
+	}
+
+	//!
+	//! QML version of Scan. @p callback is called with a list of `{ path, size, modified, hash }`
+	//! objects, and a boolean set to true on the last call.
+	//!
+	int File::scan(const QString & root, const QStringList & filters, const QJSValue & callback, const QString & cacheFile)
+	{
+		return Scan(root, filters, [this, callback] (const QVector< FileHash > & files, bool finished) {
+			QJSEngine * engine = qjsEngine(this);
+			if (engine != nullptr && callback.isCallable() == true)
+			{
+				QJSValue(callback).call({ engine->toScriptValue(ToVariant(files)), finished });
+			}
+		}, cacheFile);
+	}
+
+	//!
+	//! QML version of HashFiles. Works like scan.
+	//!
+	int File::hashFiles(const QStringList & paths, const QJSValue & callback, const QString & cacheFile)
+	{
+		return HashFiles(paths, [this, callback] (const QVector< FileHash > & files, bool finished) {
+			QJSEngine * engine = qjsEngine(this);
+			if (engine != nullptr && callback.isCallable() == true)
+			{
+				QJSValue(callback).call({ engine->toScriptValue(ToVariant(files)), finished });
+			}
+		}, cacheFile);
+	}
+
+	//!
+	//! Constructor.
+	//!
+	FileWriter::FileWriter(QObject * parent)
+		: QObject(parent)
+		, m_BufferSize(64 * 1024)
+		, m_FlushInterval(1000)
+		, m_Scheduled(false)
+		, m_Timer(this)
+	{
+		m_Timer.setSingleShot(true);
+		QObject::connect(&m_Timer, &QTimer::timeout, this, [this] (void) { Flush(); });
+	}
+
+	//!
+	//! Destructor. Flushes the pending writes.
+	//!
+	FileWriter::~FileWriter(void)
+	{
+		Flush();
+	}
+
+	//!
+	//! Get the file.
+	//!
+	QString FileWriter::GetFilename(void) const
+	{
+		QMutexLocker lock(&m_Mutex);
+		return m_File.fileName();
+	}
+
+	//!
+	//! Set the file. The pending writes are flushed to the previous one first.
+	//!
+	void FileWriter::SetFilename(const QString & filename)
+	{
+		{
+			QMutexLocker lock(&m_Mutex);
+			if (m_File.fileName() == filename)
+			{
+				return;
+			}
+			FlushLocked();
+			m_File.close();
+			m_File.setFileName(filename);
+		}
+		emit filenameChanged(filename);
+	}
+
+	//!
+	//! Get the size of the buffer, in bytes.
+	//!
+	int FileWriter::GetBufferSize(void) const
+	{
+		QMutexLocker lock(&m_Mutex);
+		return m_BufferSize;
+	}
+
+	//!
+	//! Set the size of the buffer, in bytes. As soon as the buffered writes reach that
+	//! size, they're flushed.
+	//!
+	void FileWriter::SetBufferSize(int bufferSize)
+	{
+		{
+			QMutexLocker lock(&m_Mutex);
+			if (m_BufferSize == bufferSize)
+			{
+				return;
+			}
+			m_BufferSize = bufferSize;
+			if (m_Buffer.size() >= m_BufferSize)
+			{
+				FlushLocked();
+			}
+		}
+		emit bufferSizeChanged(bufferSize);
+	}
+
+	//!
+	//! Get the flush interval, in milliseconds.
+	//!
+	int FileWriter::GetFlushInterval(void) const
+	{
+		QMutexLocker lock(&m_Mutex);
+		return m_FlushInterval;
+	}
+
+	//!
+	//! Set the maximum delay in milliseconds between a write and its flush.
+	//!
+	void FileWriter::SetFlushInterval(int flushInterval)
+	{
+		{
+			QMutexLocker lock(&m_Mutex);
+			if (m_FlushInterval == flushInterval)
+			{
+				return;
+			}
+			m_FlushInterval = flushInterval;
+		}
+		emit flushIntervalChanged(flushInterval);
+	}
+
+	//!
+	//! Buffer a write. It's flushed immediately if the buffer is full, otherwise after the
+	//! flush interval. Returns false if a flush failed.
+	//!
+	bool FileWriter::Write(const QByteArray & content)
+	{
+		QMutexLocker lock(&m_Mutex);
+		m_Buffer.append(content);
+		if (m_Buffer.size() >= m_BufferSize)
+		{
+			return FlushLocked();
+		}
+
+		// the timer can only be started from the thread of this instance
+		if (m_Scheduled == false)
+		{
+			m_Scheduled = true;
+			QMetaObject::invokeMethod(this, [this] (void) {
+				m_Timer.start(GetFlushInterval());
+			}, Qt::QueuedConnection);
+		}
+		return true;
+	}
+
+	//!
+	//! Write the pending writes to the file. Returns false if the write failed, in which
+	//! case the pending writes are lost.
+	//!
+	bool FileWriter::Flush(void)
+	{
+		QMutexLocker lock(&m_Mutex);
+		return FlushLocked();
+	}
+
+	//!
+	//! Flush, with the mutex already locked.
+	//!
+	bool FileWriter::FlushLocked(void)
+	{
+		m_Scheduled = false;
+		if (m_Buffer.isEmpty() == true)
+		{
+			return true;
+		}
+
+		// unbuffered, so that the whole buffer is written with a single system call
+		const bool ok =
+			(m_File.isOpen() == true || m_File.open(QIODevice::Append | QIODevice::Unbuffered) == true) &&
+			m_File.write(m_Buffer) == m_Buffer.size();
+		m_Buffer.clear();
+		return ok;
+	}
+
+	//!
+	//! Buffer a string, encoded in UTF-8.
+	//!
+	bool FileWriter::write(const QString & content)
+	{
+		return Write(EncodeUtf8(content));
+	}
+
+	//!
+	//! Write the pending writes to the file.
+	//!
+	bool FileWriter::flush(void)
+	{
+		return Flush();
+	}
+
+	//!
+	//! Constructor.
+	//!
+	FileLineModel::FileLineModel(QObject * parent)
+		: QAbstractListModel(parent)
+		, m_Indexed(0)
+		, m_LineCount(0)
+		, m_Progress(0.0)
+		, m_Loading(false)
+		, m_Generation(0)
+		, m_Cache(s_CachedBlocks)
+	{
+	}
+
+	//!
+	//! Destructor. Stops the indexing, if it's still running.
+	//!
+	FileLineModel::~FileLineModel(void)
+	{
+		Stop();
+	}
+
+	//!
+	//! Stop the current indexing, if any.
+	//!
+	void FileLineModel::Stop(void)
+	{
+		if (m_Cancelled != nullptr)
+		{
+			*m_Cancelled = true;
+			m_Cancelled.reset();
+		}
+	}
+
+	//!
+	//! Set the file, and start indexing it.
+	//!
+	void FileLineModel::SetSource(const QString & source)
+	{
+		if (m_Source == source)
+		{
+			return;
+		}
+
+		// reset
+		Stop();
+		beginResetModel();
+		m_Source = source;
+		m_Blocks.clear();
+		m_Indexed = 0;
+		m_LineCount = 0;
+		m_Progress = 0.0;
+		m_Cache.clear();
+		m_File.close();
+		m_File.setFileName(source);
+		endResetModel();
+		const int generation = ++m_Generation;
+		emit sourceChanged(m_Source);
+		emit lineCountChanged(m_LineCount);
+		emit progressChanged(m_Progress);
+
+		const bool loading = m_Source.isEmpty() == false && m_File.open(QIODevice::ReadOnly) == true;
+		if (m_Loading != loading)
+		{
+			m_Loading = loading;
+			emit loadingChanged(m_Loading);
+		}
+		if (loading == false)
+		{
+			return;
+		}
+
+		// index the file on a worker, by chunks so that the memory stays bounded
+		auto cancelled = m_Cancelled = std::make_shared< std::atomic< bool > >(false);
+		auto delivery = Delivery::Create(this);
+		new Job([this, delivery, source, generation, cancelled] (void) {
+			auto post = [&] (int lineCount, const QVector< qint64 > & blocks, qint64 indexed, qreal progress, bool finished) {
+				if (*cancelled == false)
+				{
+					delivery->Post([this, generation, lineCount, blocks, indexed, progress, finished] (void) {
+						Append(generation, lineCount, blocks, indexed, progress, finished);
+					});
+				}
+			};
+
+			QFile file(source);
+			if (file.open(QIODevice::ReadOnly) == false)
+			{
+				post(0, {}, 0, 1.0, true);
+				return;
+			}
+
+			const qint64 size = file.size();
+			QVector< qint64 > blocks{ 0 };
+			int lines = 0;
+			qint64 offset = 0, indexed = 0;
+			QElapsedTimer timer;
+			timer.start();
+			bool first = true;
+			while (*cancelled == false)
+			{
+				const QByteArray chunk = file.read(1024 * 1024);
+				if (chunk.isEmpty() == true)
+				{
+					break;
+				}
+				for (const char * data = chunk.constData(), * end = data + chunk.size(), * found; (found = static_cast< const char * >(memchr(data, '\n', end - data))) != nullptr; data = found + 1)
+				{
+					indexed = offset + (found - chunk.constData()) + 1;
+					if (++lines % s_BlockSize == 0)
+					{
+						blocks.push_back(indexed);
+					}
+				}
+				offset += chunk.size();
+
+				// the first lines as soon as possible, then regular batches
+				if (first == true || timer.elapsed() >= 100)
+				{
+					post(lines, blocks, indexed, size > 0 ? static_cast< qreal >(offset) / size : 1.0, false);
+					blocks.clear();
+					timer.restart();
+					first = false;
+				}
+			}
+
+			// the last line might not end with a new line
+			post(lines + (offset > indexed ? 1 : 0), blocks, offset, 1.0, true);
+		}, "FileLineModel");
+	}
+
+	//!
+	//! Add the lines indexed by the worker.
+	//!
+	void FileLineModel::Append(int generation, int lineCount, const QVector< qint64 > & blocks, qint64 indexed, qreal progress, bool finished)
+	{
+		if (generation != m_Generation)
+		{
+			return;
+		}
+
+		// the last block was read up to the previous end of the index
+		m_Cache.remove(m_LineCount / s_BlockSize);
+		m_Cache.remove(qMax(0, m_LineCount - 1) / s_BlockSize);
+		m_Blocks += blocks;
+		m_Indexed = indexed;
+
+		if (lineCount > m_LineCount)
+		{
+			beginInsertRows(QModelIndex(), m_LineCount, lineCount - 1);
+			m_LineCount = lineCount;
+			endInsertRows();
+			emit lineCountChanged(m_LineCount);
+		}
+		if (m_Progress != progress)
+		{
+			m_Progress = progress;
+			emit progressChanged(m_Progress);
+		}
+		if (finished == true)
+		{
+			m_Cancelled.reset();
+			m_Loading = false;
+			emit loadingChanged(m_Loading);
+		}
+	}
+
+	//!
+	//! Get the lines of a block, reading them from the file if they're not cached.
+	//!
+	const QStringList * FileLineModel::GetBlock(int block) const
+	{
+		if (block < 0 || block >= m_Blocks.size())
+		{
+			return nullptr;
+		}
+
+		const QStringList * lines = m_Cache.object(block);
+		if (lines == nullptr)
+		{
+			const qint64 start = m_Blocks[block];
+			const qint64 end = block + 1 < m_Blocks.size() ? m_Blocks[block + 1] : m_Indexed;
+			if (m_File.seek(start) == false)
+			{
+				return nullptr;
+			}
+			QByteArray data = m_File.read(end - start);
+			if (data.endsWith('\n') == true)
+			{
+				data.chop(1);
+			}
+
+			auto result = new QStringList(DecodeUtf8(data).split('\n'));
+			for (QString & line : *result)
+			{
+				if (line.endsWith('\r') == true)
+				{
+					line.chop(1);
+				}
+			}
+			lines = result;
+			m_Cache.insert(block, result);
+		}
+		return lines;
+	}
+
+	//!
+	//! Get a line, or an empty string if @p index is out of range.
+	//!
+	QString FileLineModel::line(int index) const
+	{
+		if (index < 0 || index >= m_LineCount)
+		{
+			return QString();
+		}
+		const QStringList * lines = GetBlock(index / s_BlockSize);
+		return lines != nullptr ? lines->value(index % s_BlockSize) : QString();
+	}
+
+	//!
+	//! Reimplemented from QAbstractListModel::rowCount
+	//!
+	int FileLineModel::rowCount(const QModelIndex & parent) const
+	{
+		return parent.isValid() == true ? 0 : m_LineCount;
+	}
+
+	//!
+	//! Reimplemented from QAbstractListModel::data
+	//!
+	QVariant FileLineModel::data(const QModelIndex & index, int role) const
+	{
+		switch (role)
+		{
+			case Qt::DisplayRole:
+			case LineRole:
+				return line(index.row());
+
+			case LineNumberRole:
+				return index.row() + 1;
+
+			default:
+				return QVariant();
+		}
+	}
 
-//!
-//! Writes a string into a file. This will overwrites any previous content, if
-//! @p filename already exists. It returns true if the operation succeeded.
-//!
-bool File::write(const QString & filename, const QString & content)
-{
-	QFile file(filename);
-	if (file.open(QIODevice::WriteOnly) == false)
+	//!
+	//! Reimplemented from QAbstractListModel::roleNames
+	//!
+	QHash< int, QByteArray > FileLineModel::roleNames(void) const
 	{
-		return false;
+		return {
+			{ LineRole,			"line" },
+			{ LineNumberRole,	"lineNumber" },
+		};
 	}
 
-	file.write(content.toLocal8Bit());
-	return true;
-}
+QT_UTILS_NAMESPACE_END
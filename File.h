@@ -2,29 +2,509 @@
 #define QT_UTILS_FILE_H
 
 #include "./Setup.h"
+#include "./Utf8.h"
 
+#include <QAbstractListModel>
+#include <QByteArray>
+#include <QCache>
+#include <QDateTime>
+#include <QFile>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QJSValue>
+#include <QMutex>
 #include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+#include <memory>
 
 
 QT_UTILS_NAMESPACE_BEGIN
 
+	//!
+	//! Read-only memory mapping of a file. The content is exposed without any copy, and
+	//! only converted to a string when explicitly requested:
+	//!
+	//! ```.cpp
+	//! MappedFile file("some/big/file.txt");
+	//! if (file.IsValid() == true)
+	//! {
+	//! 	// view on the mapped data, no copy
+	//! 	const QByteArray bytes = file.GetBytes();
+	//!
+	//! 	// decoded from UTF-8 only here
+	//! 	const QString text = file.ToString();
+	//! }
+	//! ```
+	//!
+	//! Copies share the same mapping, which is released when the last copy is destroyed.
+	//! The views returned by GetData and GetBytes don't own the mapping: they must not
+	//! outlive it.
+	//!
+	class MappedFile
+	{
+
+	public:
+
+		// constructors
+		MappedFile(void);
+		MappedFile(const QString & filename);
+
+		// C++ API
+		bool			IsValid(void) const;
+		qint64			GetSize(void) const;
+		const char *	GetData(void) const;
+		QByteArray		GetBytes(void) const;
+		QString			ToString(Utf8Mode mode = Utf8Mode::Replace, qint64 * errorOffset = nullptr) const;
+
+	private:
+
+		//! The mapping, shared by the copies
+		struct Data;
+		std::shared_ptr< const Data > m_Data;
+
+	};
+
 	//!
 	//! Simple utility to read and write file from / to the disk.
 	//!
+	//! The synchronous `read` and `write` block the calling thread for the whole operation,
+	//! which freezes the UI when used from QML on a slow disk. The asynchronous versions do
+	//! the I/O on a Job worker, and call the callback from the thread of the File instance:
+	//!
+	//! ```.qml
+	//! const id = file.readAsync("some/file.txt", function (content, ok) { ... })
+	//! file.writeAsync("some/file.txt", content, function (ok) { ... })
+	//!
+	//! // the callback of a cancelled operation is never called
+	//! file.cancel(id)
+	//! ```
+	//!
+	//! Files are read and written in UTF-8 (see Utf8.h) Invalid sequences are replaced by
+	//! U+FFFD by read, while readStrict reports them.
+	//!
+	//! Writes are atomic by default: the content goes to a temporary file which then replaces
+	//! the previous one, so a crash never leaves a half-written file. For many small writes
+	//! to the same file, use a FileWriter instead.
+	//!
+	//! Files which are read many times (configurations, templates, etc.) can be cached by
+	//! setting cacheSize. A cached content is checked against the modification time and size
+	//! of the file before being used, and the cached files are watched: when one changes, it's
+	//! removed from the cache and fileChanged is emitted.
+	//!
+	//! Finally, folders can be scanned and files hashed (with XXH64, a fast non-cryptographic
+	//! hash) in parallel on the Job pool, to detect changes in big folders. The results are
+	//! delivered by batches while it goes:
+	//!
+	//! ```.qml
+	//! file.scan("some/folder", [ "*.jpg", "*.png" ], function (files, finished) {
+	//! 	// files is a list of { path, size, modified, hash } objects. hash is an hexadecimal string
+	//! }, "some/folder/.hashes")
+	//! ```
+	//!
+	//! The last argument is an optional cache file of the hashes: files whose size and
+	//! modification time didn't change since the previous scan are not read again, even if
+	//! that scan was cancelled before the end.
+	//!
 	class File
 		: public QObject
 	{
 
 		Q_OBJECT
 
+	private:
+
+		Q_PROPERTY(int cacheSize	READ GetCacheSize	WRITE SetCacheSize	NOTIFY cacheSizeChanged)
+
+	signals:
+
+		void cacheSizeChanged(int cacheSize);
+		void fileChanged(QString path);
+
 	public:
 
+		//! How write replaces the content of a file
+		enum WriteMode
+		{
+			//! Write to a temporary file, then replace the file with it
+			Atomic,
+
+			//! Truncate the file and write in place
+			Truncate,
+
+			//! Append to the end of the file
+			Append
+		};
+		Q_ENUM(WriteMode)
+
+		//!
+		//! Statistics of the content cache.
+		//!
+		struct CacheStats
+		{
+			//! Number of reads served from the cache
+			qint64 hits = 0;
+
+			//! Number of reads of cacheable files which weren't in the cache, or were outdated
+			qint64 misses = 0;
+
+			//! Number of cached files
+			int entries = 0;
+
+			//! Memory used by the cached contents, in bytes
+			qint64 memory = 0;
+		};
+
+		//!
+		//! A hashed file.
+		//!
+		struct FileHash
+		{
+			//! Path of the file
+			QString path;
+
+			//! Size of the file
+			qint64 size = 0;
+
+			//! Modification time of the file
+			QDateTime modified;
+
+			//! XXH64 hash of the content
+			quint64 hash = 0;
+		};
+
+		//!
+		//! Defines the signature of a function like object called with each batch of hashed
+		//! files. @p finished is true for the last call, whose batch can be empty.
+		//!
+		typedef std::function< void (const QVector< FileHash > & files, bool finished) > HashCallback;
+
+		// constructor
+		File(QObject * parent = nullptr);
+
+		// C++ API
+		static QString			Read(const QString & filename, Utf8Mode mode = Utf8Mode::Replace, bool * ok = nullptr, qint64 * errorOffset = nullptr);
+		int						GetCacheSize(void) const;
+		void					SetCacheSize(int cacheSize);
+		CacheStats				GetCacheStats(void) const;
+		void					ClearCache(void);
+		int						Scan(const QString & root, const QStringList & filters, const HashCallback & callback, const QString & cacheFile = QString());
+		int						HashFiles(const QStringList & paths, const HashCallback & callback, const QString & cacheFile = QString());
+		static bool				Write(const QString & filename, const QString & content, WriteMode mode = Atomic);
+		static bool				Write(const QString & filename, const QByteArray & content, WriteMode mode = Atomic);
+
 		// QML API
 		Q_INVOKABLE QString		read(const QString & filename);
-		Q_INVOKABLE bool		write(const QString & filename, const QString & content);
+		Q_INVOKABLE QVariantMap	readStrict(const QString & filename);
+		Q_INVOKABLE bool		write(const QString & filename, const QString & content, WriteMode mode = Atomic);
+		Q_INVOKABLE int			readAsync(const QString & filename, const QJSValue & callback);
+		Q_INVOKABLE int			writeAsync(const QString & filename, const QString & content, const QJSValue & callback = QJSValue(), WriteMode mode = Atomic);
+		Q_INVOKABLE bool		cancel(int id);
+		Q_INVOKABLE QVariantMap	cacheStats(void) const;
+		Q_INVOKABLE void		clearCache(void);
+		Q_INVOKABLE int			scan(const QString & root, const QStringList & filters, const QJSValue & callback, const QString & cacheFile = QString());
+		Q_INVOKABLE int			hashFiles(const QStringList & paths, const QJSValue & callback, const QString & cacheFile = QString());
+
+	private:
+
+		//!
+		//! A cached content.
+		//!
+		struct CacheEntry
+		{
+			//! The content
+			QString content;
+
+			//! Modification time of the file when it was read
+			QDateTime modified;
+
+			//! Size of the file when it was read
+			qint64 size;
+		};
+
+		//!
+		//! A pending asynchronous operation.
+		//!
+		struct Operation
+		{
+			//! The QML callback. Only used from the thread of the File instance
+			QJSValue callback;
+
+			//! The callback of the hashing operations, also only used from that thread
+			HashCallback hashCallback;
+
+			//! Set when the operation is cancelled
+			std::shared_ptr< std::atomic< bool > > cancelled;
+		};
+
+		//! The state of a hashing operation, shared by its jobs
+		struct HashState;
+
+		// private API
+		int		Start(const QJSValue & callback, const std::function< QVariantList (void) > & operation);
+		void	Invalidate(const QString & filename);
+		void	PruneWatcher(void);
+		void	OnFileChanged(const QString & path);
+		int		StartHashing(const HashCallback & callback, const QString & cacheFile, const std::function< void (const std::shared_ptr< HashState > & state) > & enumerate);
+		void	DeliverHashes(int id, const QVector< FileHash > & files, bool finished);
+		static void	HashBatch(const std::shared_ptr< HashState > & state, const QStringList & paths);
+		static void	ReleaseHashing(const std::shared_ptr< HashState > & state);
+		static void	PostHashes(const std::shared_ptr< HashState > & state, const QVector< FileHash > & files, bool finished);
+		static QVariantList	ToVariant(const QVector< FileHash > & files);
+
+		//! Pending operations, by id
+		QHash< int, Operation > m_Operations;
+
+		//! Next operation id
+		int m_NextId = 0;
+
+		//! Cached contents, by absolute path. The cost is the memory used by the content
+		QCache< QString, CacheEntry > m_Cache;
+
+		//! Number of reads served from the cache
+		qint64 m_CacheHits = 0;
+
+		//! Number of cache misses
+		qint64 m_CacheMisses = 0;
+
+		//! Watches the cached files. Created with the first cached file
+		QFileSystemWatcher * m_Watcher = nullptr;
 
 	};
 
+	//!
+	//! Buffered writer, appending to a file. Small writes are collected in memory and written
+	//! in one go once the buffer reaches bufferSize, or flushInterval milliseconds after the
+	//! first buffered write, so frequent small writes (logs, journals, etc.) don't cost one
+	//! system call each:
+	//!
+	//! ```.qml
+	//! FileWriter {
+	//! 	id: log
+	//! 	filename: "some/file.log"
+	//! }
+	//!
+	//! log.write("something happened\n")
+	//! ```
+	//!
+	//! The C++ API can be used from any thread. The buffer is flushed when the file changes
+	//! and when the writer is destroyed.
+	//!
+	class FileWriter
+		: public QObject
+	{
+
+		Q_OBJECT
+
+	private:
+
+		Q_PROPERTY(QString filename		READ GetFilename		WRITE SetFilename		NOTIFY filenameChanged)
+		Q_PROPERTY(int bufferSize		READ GetBufferSize		WRITE SetBufferSize		NOTIFY bufferSizeChanged)
+		Q_PROPERTY(int flushInterval	READ GetFlushInterval	WRITE SetFlushInterval	NOTIFY flushIntervalChanged)
+
+	signals:
+
+		void filenameChanged(QString filename);
+		void bufferSizeChanged(int bufferSize);
+		void flushIntervalChanged(int flushInterval);
+
+	public:
+
+		// constructor / destructor
+		FileWriter(QObject * parent = nullptr);
+		~FileWriter(void);
+
+		// C++ API
+		QString		GetFilename(void) const;
+		void		SetFilename(const QString & filename);
+		int			GetBufferSize(void) const;
+		void		SetBufferSize(int bufferSize);
+		int			GetFlushInterval(void) const;
+		void		SetFlushInterval(int flushInterval);
+		bool		Write(const QByteArray & content);
+		bool		Flush(void);
+
+		// QML API
+		Q_INVOKABLE bool	write(const QString & content);
+		Q_INVOKABLE bool	flush(void);
+
+	private:
+
+		// private API
+		bool	FlushLocked(void);
+
+		//! Protects the state, since the C++ API can be used from any thread
+		mutable QMutex m_Mutex;
+
+		//! The file, opened on the first flush
+		QFile m_File;
+
+		//! The pending writes
+		QByteArray m_Buffer;
+
+		//! Size of the buffer which triggers a flush
+		int m_BufferSize;
+
+		//! Maximum delay in milliseconds before buffered writes are flushed
+		int m_FlushInterval;
+
+		//! True when a delayed flush is scheduled
+		bool m_Scheduled;
+
+		//! Timer of the delayed flushes
+		QTimer m_Timer;
+
+	};
+
+	//!
+	//! Read-only model exposing the lines of a text file, meant to display big files (e.g.
+	//! logs of hundreds of MB) in a QML ListView:
+	//!
+	//! ```.qml
+	//! ListView {
+	//! 	model: FileLineModel { source: "some/big/file.log" }
+	//! 	delegate: Text { text: model.line }
+	//! }
+	//! ```
+	//!
+	//! The file is indexed on a Job worker, and the lines are added to the model by batches
+	//! while it goes, so the first lines are displayed immediately. Only the offset of one
+	//! line out of s_BlockSize is kept, and the lines are read from the file on demand, by
+	//! blocks, a bounded number of them being cached. So the memory stays small whatever
+	//! the size of the file.
+	//!
+	class FileLineModel
+		: public QAbstractListModel
+	{
+
+		Q_OBJECT
+
+	private:
+
+		Q_PROPERTY(QString source	READ GetSource		WRITE SetSource		NOTIFY sourceChanged)
+		Q_PROPERTY(int lineCount	READ GetLineCount						NOTIFY lineCountChanged)
+		Q_PROPERTY(bool loading		READ IsLoading							NOTIFY loadingChanged)
+		Q_PROPERTY(qreal progress	READ GetProgress						NOTIFY progressChanged)
+
+	signals:
+
+		void sourceChanged(QString source);
+		void lineCountChanged(int lineCount);
+		void loadingChanged(bool loading);
+		void progressChanged(qreal progress);
+
+	public:
+
+		//! The roles
+		enum Roles
+		{
+			LineRole = Qt::UserRole + 1,
+			LineNumberRole
+		};
+
+		// constructor / destructor
+		FileLineModel(QObject * parent = nullptr);
+		~FileLineModel(void);
+
+		// C++ API
+		inline const QString &	GetSource(void) const;
+		void					SetSource(const QString & source);
+		inline int				GetLineCount(void) const;
+		inline bool				IsLoading(void) const;
+		inline qreal			GetProgress(void) const;
+
+		// QML API
+		Q_INVOKABLE QString		line(int index) const;
+
+		// reimplemented from QAbstractListModel
+		int						rowCount(const QModelIndex & parent = QModelIndex()) const override;
+		QVariant				data(const QModelIndex & index, int role = Qt::DisplayRole) const override;
+		QHash< int, QByteArray >	roleNames(void) const override;
+
+	private:
+
+		//! Number of lines per block: only the offset of the first line of each block is kept
+		static constexpr int s_BlockSize = 64;
+
+		//! Maximum number of blocks kept in memory
+		static constexpr int s_CachedBlocks = 256;
+
+		// private API
+		void	Stop(void);
+		void	Append(int generation, int lineCount, const QVector< qint64 > & blocks, qint64 indexed, qreal progress, bool finished);
+		const QStringList *	GetBlock(int block) const;
+
+		//! The file
+		QString m_Source;
+
+		//! Handle used to read the blocks
+		mutable QFile m_File;
+
+		//! Offsets of the first line of each block
+		QVector< qint64 > m_Blocks;
+
+		//! Offset of the end of the last indexed line
+		qint64 m_Indexed;
+
+		//! Number of lines
+		int m_LineCount;
+
+		//! Indexing progress
+		qreal m_Progress;
+
+		//! True while the file is indexed
+		bool m_Loading;
+
+		//! Incremented on each source change, to drop the results of the previous indexing
+		int m_Generation;
+
+		//! Set to stop the current indexing
+		std::shared_ptr< std::atomic< bool > > m_Cancelled;
+
+		//! Recently read blocks
+		mutable QCache< int, QStringList > m_Cache;
+
+	};
+
+	//!
+	//! Get the file.
+	//!
+	inline const QString & FileLineModel::GetSource(void) const
+	{
+		return m_Source;
+	}
+
+	//!
+	//! Get the number of lines indexed so far.
+	//!
+	inline int FileLineModel::GetLineCount(void) const
+	{
+		return m_LineCount;
+	}
+
+	//!
+	//! Returns true while the file is being indexed.
+	//!
+	inline bool FileLineModel::IsLoading(void) const
+	{
+		return m_Loading;
+	}
+
+	//!
+	//! Get the indexing progress, between 0 and 1.
+	//!
+	inline qreal FileLineModel::GetProgress(void) const
+	{
+		return m_Progress;
+	}
+
 QT_UTILS_NAMESPACE_END
 
 
@@ -0,0 +1,475 @@
+#include "./HttpCache.h"
+
+#include <QCache>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <atomic>
+#include <limits>
+
+
+QT_UTILS_NAMESPACE_BEGIN
+
+	//! Magic number of the disk entries
+	static constexpr quint32 s_Magic = 0x43485551;
+
+	//! Version of the disk entries
+	static constexpr qint32 s_Version = 1;
+
+	//!
+	//! The cache data, protected by a mutex.
+	//!
+	struct CacheData
+	{
+		QMutex mutex;
+		QCache< QString, HttpCache::Entry > memory{ 32 * 1024 * 1024 };
+		QString directory;
+		qint64 diskCapacity = 256 * 1024 * 1024;
+		qint64 diskBytes = -1;
+		HttpCache::Stats stats{};
+	};
+
+	//! Enabled state
+	static std::atomic< bool > s_Enabled{ false };
+
+	//!
+	//! Get the cache data.
+	//!
+	static CacheData & GetData(void)
+	{
+		static CacheData data;
+		return data;
+	}
+
+	//!
+	//! Get the key of a url in the cache.
+	//!
+	static inline QString GetKey(const QUrl & url)
+	{
+		return url.toString(QUrl::FullyEncoded);
+	}
+
+	//!
+	//! Get the directory of the disk tier. The cache mutex must be locked.
+	//!
+	static QString GetDirectoryUnsafe(CacheData & data)
+	{
+		if (data.directory.isEmpty() == true)
+		{
+			data.directory = QString("%1/HttpCache")
+				.arg(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+		}
+		return data.directory;
+	}
+
+	//!
+	//! Get the path of the disk entry of a given key. The cache mutex must be locked.
+	//!
+	static QString GetPath(CacheData & data, const QString & key)
+	{
+		return QString("%1/%2")
+			.arg(GetDirectoryUnsafe(data))
+			.arg(QString(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex()));
+	}
+
+	//!
+	//! Get the disk tier size, computing it on first use. The cache mutex must be locked.
+	//!
+	static qint64 GetDiskBytes(CacheData & data)
+	{
+		if (data.diskBytes == -1)
+		{
+			data.diskBytes = 0;
+			for (const QFileInfo & info : QDir(GetDirectoryUnsafe(data)).entryInfoList(QDir::Files))
+			{
+				data.diskBytes += info.size();
+			}
+		}
+		return data.diskBytes;
+	}
+
+	//!
+	//! Remove the least recently written disk entries until the disk tier fits in
+	//! its capacity. The cache mutex must be locked.
+	//!
+	static void TrimDisk(CacheData & data)
+	{
+		if (GetDiskBytes(data) <= data.diskCapacity)
+		{
+			return;
+		}
+
+		// remove down to 90% to avoid doing this on every insertion
+		const qint64 target = data.diskCapacity - data.diskCapacity / 10;
+		QFileInfoList files = QDir(GetDirectoryUnsafe(data)).entryInfoList(QDir::Files, QDir::Time);
+		while (files.isEmpty() == false && data.diskBytes > target)
+		{
+			const QFileInfo info = files.takeLast();
+			if (QFile::remove(info.absoluteFilePath()) == true)
+			{
+				data.diskBytes -= info.size();
+			}
+		}
+	}
+
+	//!
+	//! Parse an HTTP date.
+	//!
+	static QDateTime ParseDate(const QByteArray & value)
+	{
+		QDateTime date = QLocale::c().toDateTime(QString::fromLatin1(value.trimmed()), "ddd, dd MMM yyyy hh:mm:ss 'GMT'");
+		date.setTimeSpec(Qt::UTC);
+		return date;
+	}
+
+	//!
+	//! Enable or disable the cache.
+	//!
+	void HttpCache::SetEnabled(bool enabled)
+	{
+		s_Enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	//!
+	//! Returns true if the cache is enabled.
+	//!
+	bool HttpCache::IsEnabled(void)
+	{
+		return s_Enabled.load(std::memory_order_relaxed);
+	}
+
+	//!
+	//! Set the capacity of the memory tier, in bytes. Defaults to 32MB.
+	//!
+	void HttpCache::SetMemoryCapacity(qint64 bytes)
+	{
+		CacheData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		data.memory.setMaxCost(static_cast< int >(qBound(qint64(0), bytes, qint64(std::numeric_limits< int >::max()))));
+	}
+
+	//!
+	//! Set the capacity of the disk tier, in bytes. Defaults to 256MB. Setting it to
+	//! 0 disables the disk tier.
+	//!
+	void HttpCache::SetDiskCapacity(qint64 bytes)
+	{
+		CacheData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		data.diskCapacity = qMax(qint64(0), bytes);
+		TrimDisk(data);
+	}
+
+	//!
+	//! Set the directory of the disk tier. Defaults to a `HttpCache` folder in
+	//! `QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)`
+	//!
+	void HttpCache::SetDirectory(const QString & path)
+	{
+		CacheData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		data.directory = path;
+		data.diskBytes = -1;
+	}
+
+	//!
+	//! Get the directory of the disk tier.
+	//!
+	QString HttpCache::GetDirectory(void)
+	{
+		CacheData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		return GetDirectoryUnsafe(data);
+	}
+
+	//!
+	//! Look for the cached response of @p url, first in memory, then on disk.
+	//! Returns true and fills @p entry if found, whether it's fresh or not. The disk
+	//! entry is read outside the lock, so that network threads don't wait on each other.
+	//!
+	bool HttpCache::Find(const QUrl & url, Entry & entry)
+	{
+		const QString key = GetKey(url);
+		CacheData & data = GetData();
+		QString path;
+		{
+			QMutexLocker lock(&data.mutex);
+
+			// memory tier
+			if (const Entry * cached = data.memory.object(key))
+			{
+				entry = *cached;
+				return true;
+			}
+			if (data.diskCapacity == 0)
+			{
+				return false;
+			}
+			path = GetPath(data, key);
+		}
+
+		// disk tier
+		QFile file(path);
+		if (file.open(QIODevice::ReadOnly) == false)
+		{
+			return false;
+		}
+		QDataStream stream(&file);
+		stream.setVersion(QDataStream::Qt_5_12);
+		quint32 magic = 0;
+		qint32 version = 0;
+		QString cachedKey;
+		stream >> magic >> version;
+		if (magic != s_Magic || version != s_Version)
+		{
+			return false;
+		}
+		stream >> cachedKey >> entry.etag >> entry.lastModified >> entry.expires >> entry.data;
+		if (stream.status() != QDataStream::Ok || cachedKey != key)
+		{
+			return false;
+		}
+
+		// promote to the memory tier
+		QMutexLocker lock(&data.mutex);
+		data.memory.insert(key, new Entry(entry), entry.data.size());
+		return true;
+	}
+
+	//!
+	//! Insert or replace the cached response of @p url in both tiers. The disk entry is
+	//! written outside the lock (atomically, so concurrent readers never see a partial one).
+	//!
+	void HttpCache::Insert(const QUrl & url, const Entry & entry)
+	{
+		const QString key = GetKey(url);
+		CacheData & data = GetData();
+		QString directory, path;
+		{
+			QMutexLocker lock(&data.mutex);
+
+			// memory tier
+			data.memory.insert(key, new Entry(entry), entry.data.size());
+			if (data.diskCapacity == 0)
+			{
+				return;
+			}
+			directory = GetDirectoryUnsafe(data);
+			path = GetPath(data, key);
+		}
+
+		// disk tier
+		if (QDir().mkpath(directory) == false)
+		{
+			return;
+		}
+		const qint64 previousSize = QFileInfo(path).size();
+		QSaveFile file(path);
+		if (file.open(QIODevice::WriteOnly) == false)
+		{
+			return;
+		}
+		QDataStream stream(&file);
+		stream.setVersion(QDataStream::Qt_5_12);
+		stream << s_Magic << s_Version << key << entry.etag << entry.lastModified << entry.expires << entry.data;
+		if (stream.status() != QDataStream::Ok || file.commit() == false)
+		{
+			return;
+		}
+		const qint64 size = QFileInfo(path).size();
+
+		// update the size of the disk tier (it's computed from the directory on first use)
+		QMutexLocker lock(&data.mutex);
+		if (data.diskBytes != -1)
+		{
+			data.diskBytes += size - previousSize;
+		}
+		TrimDisk(data);
+	}
+
+	//!
+	//! Remove the cached response of @p url.
+	//!
+	void HttpCache::Remove(const QUrl & url)
+	{
+		const QString key = GetKey(url);
+		CacheData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		data.memory.remove(key);
+		const QString path = GetPath(data, key);
+		const qint64 size = QFileInfo(path).size();
+		if (QFile::remove(path) == true && data.diskBytes != -1)
+		{
+			data.diskBytes -= size;
+		}
+	}
+
+	//!
+	//! Clear both tiers.
+	//!
+	void HttpCache::Clear(void)
+	{
+		CacheData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		data.memory.clear();
+		QDir directory(GetDirectoryUnsafe(data));
+		for (const QString & file : directory.entryList(QDir::Files))
+		{
+			directory.remove(file);
+		}
+		data.diskBytes = -1;
+	}
+
+	//!
+	//! Get the cache statistics.
+	//!
+	HttpCache::Stats HttpCache::GetStats(void)
+	{
+		CacheData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		Stats stats = data.stats;
+		stats.memoryBytes	= data.memory.totalCost();
+		stats.diskBytes		= data.diskCapacity > 0 ? GetDiskBytes(data) : 0;
+		return stats;
+	}
+
+	//!
+	//! Reset the hit, miss and byte counters.
+	//!
+	void HttpCache::ResetStats(void)
+	{
+		CacheData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		data.stats = Stats{};
+	}
+
+	//!
+	//! Returns true if @p entry can be used without revalidation.
+	//!
+	bool HttpCache::IsFresh(const Entry & entry)
+	{
+		return entry.expires.isValid() == true && entry.expires > QDateTime::currentDateTimeUtc();
+	}
+
+	//!
+	//! Add the conditional headers needed to revalidate @p entry to @p request.
+	//!
+	void HttpCache::AddValidators(const Entry & entry, QNetworkRequest & request)
+	{
+		if (entry.etag.isEmpty() == false)
+		{
+			request.setRawHeader("If-None-Match", entry.etag);
+		}
+		if (entry.lastModified.isEmpty() == false)
+		{
+			request.setRawHeader("If-Modified-Since", entry.lastModified);
+		}
+	}
+
+	//!
+	//! Returns true if @p reply is a 304 Not Modified reply.
+	//!
+	bool HttpCache::IsNotModified(QNetworkReply * reply)
+	{
+		return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304;
+	}
+
+	//!
+	//! Update the validators and expiration date of @p entry from the headers of @p reply.
+	//! Returns false if the response must not be cached.
+	//!
+	bool HttpCache::Update(QNetworkReply * reply, Entry & entry)
+	{
+		const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+		if (status != 200 && status != 304)
+		{
+			return false;
+		}
+
+		// validators (a 304 may omit them, in which case we keep the previous ones)
+		if (reply->hasRawHeader("ETag") == true)
+		{
+			entry.etag = reply->rawHeader("ETag");
+		}
+		if (reply->hasRawHeader("Last-Modified") == true)
+		{
+			entry.lastModified = reply->rawHeader("Last-Modified");
+		}
+
+		// freshness. max-age has precedence over Expires
+		const QDateTime now = QDateTime::currentDateTimeUtc();
+		bool hasFreshness = false;
+		for (const QByteArray & directive : reply->rawHeader("Cache-Control").toLower().split(','))
+		{
+			const QByteArray value = directive.trimmed();
+			if (value == "no-store")
+			{
+				return false;
+			}
+			else if (value == "no-cache")
+			{
+				entry.expires = now;
+				hasFreshness = true;
+			}
+			else if (value.startsWith("max-age=") == true && hasFreshness == false)
+			{
+				entry.expires = now.addSecs(value.mid(8).toLongLong());
+				hasFreshness = true;
+			}
+		}
+		if (hasFreshness == false && reply->hasRawHeader("Expires") == true)
+		{
+			// an invalid date means already expired
+			entry.expires = ParseDate(reply->rawHeader("Expires"));
+			if (entry.expires.isValid() == false)
+			{
+				entry.expires = now;
+			}
+			hasFreshness = true;
+		}
+
+		// without freshness information, only keep it if we can revalidate it
+		if (hasFreshness == false)
+		{
+			if (entry.etag.isEmpty() == true && entry.lastModified.isEmpty() == true)
+			{
+				return false;
+			}
+			entry.expires = now;
+		}
+		return true;
+	}
+
+	//!
+	//! Record a request served from the cache.
+	//!
+	void HttpCache::Hit(qint64 bytes, bool revalidated)
+	{
+		CacheData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		++(revalidated == true ? data.stats.revalidations : data.stats.hits);
+		data.stats.bytesFromCache += bytes;
+	}
+
+	//!
+	//! Record a request that had to download its body.
+	//!
+	void HttpCache::Miss(qint64 bytes)
+	{
+		CacheData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		++data.stats.misses;
+		data.stats.bytesFromNetwork += bytes;
+	}
+
+QT_UTILS_NAMESPACE_END
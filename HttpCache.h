@@ -0,0 +1,111 @@
+#ifndef QT_UTILS_HTTP_CACHE_H
+#define QT_UTILS_HTTP_CACHE_H
+
+#include "./Setup.h"
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+#include <QUrl>
+
+QT_BEGIN_NAMESPACE
+class QNetworkReply;
+class QNetworkRequest;
+QT_END_NAMESPACE
+
+
+QT_UTILS_NAMESPACE_BEGIN
+
+	//!
+	//! Response cache used by RequestUrl. It has 2 tiers: a bounded in-memory LRU, and
+	//! a persistent on-disk one. Freshness is computed from the Cache-Control and
+	//! Expires headers, and stale entries are revalidated using If-None-Match and
+	//! If-Modified-Since, so that a 304 reply is served from the cache.
+	//!
+	//! It's disabled by default. To use it, just enable it once:
+	//!
+	//! ```.cpp
+	//! HttpCache::SetEnabled(true);
+	//! ```
+	//!
+	//! and every RequestUrl call will then go through it. Only successful (200) GET
+	//! requests are cached, and streamed requests never are.
+	//!
+	class HttpCache
+	{
+
+	public:
+
+		//!
+		//! A cached response.
+		//!
+		struct Entry
+		{
+			//! The body of the response
+			QByteArray data;
+
+			//! The ETag header, if any
+			QByteArray etag;
+
+			//! The Last-Modified header, if any
+			QByteArray lastModified;
+
+			//! Date (UTC) until which the entry can be used without revalidation
+			QDateTime expires;
+		};
+
+		//!
+		//! Cache statistics.
+		//!
+		struct Stats
+		{
+			//! Requests served from the cache without touching the network
+			qint64 hits;
+
+			//! Requests served from the cache after a 304 revalidation
+			qint64 revalidations;
+
+			//! Requests that had to download the body
+			qint64 misses;
+
+			//! Bytes served from the cache
+			qint64 bytesFromCache;
+
+			//! Bytes downloaded by the requests going through the cache
+			qint64 bytesFromNetwork;
+
+			//! Current size of the memory tier
+			qint64 memoryBytes;
+
+			//! Current size of the disk tier
+			qint64 diskBytes;
+		};
+
+		// C++ API
+		static void		SetEnabled(bool enabled);
+		static bool		IsEnabled(void);
+		static void		SetMemoryCapacity(qint64 bytes);
+		static void		SetDiskCapacity(qint64 bytes);
+		static void		SetDirectory(const QString & path);
+		static QString	GetDirectory(void);
+		static bool		Find(const QUrl & url, Entry & entry);
+		static void		Insert(const QUrl & url, const Entry & entry);
+		static void		Remove(const QUrl & url);
+		static void		Clear(void);
+		static Stats	GetStats(void);
+		static void		ResetStats(void);
+
+		// used by RequestUrl
+		static bool		IsFresh(const Entry & entry);
+		static void		AddValidators(const Entry & entry, QNetworkRequest & request);
+		static bool		IsNotModified(QNetworkReply * reply);
+		static bool		Update(QNetworkReply * reply, Entry & entry);
+		static void		Hit(qint64 bytes, bool revalidated);
+		static void		Miss(qint64 bytes);
+
+	};
+
+QT_UTILS_NAMESPACE_END
+
+
+#endif
@@ -1,90 +1,1489 @@
 #include "./HttpRequest.h"
+#include "./HttpCache.h"
 
+#include <QBuffer>
+#include <QCache>
+#include <QCoreApplication>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
 #include <QEventLoop>
+#include <QFile>
+#include <QHash>
+#include <QJsonParseError>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QNetworkAccessManager>
 #include <QNetworkRequest>
 #include <QNetworkReply>
+#include <QPair>
+#include <QPointer>
+#include <QRandomGenerator>
 #include <QRegularExpression>
+#include <QSaveFile>
+#include <QSslConfiguration>
+#include <QThread>
+#include <QTimer>
 #include <QUrl>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
 
 
 QT_UTILS_NAMESPACE_BEGIN
 
-	//! The network manager
-	QNetworkAccessManager s_NetworkManager;
+	//!
+	//! Pool of network threads. Each thread runs its own event loop and owns a
+	//! network manager, so that requests are processed in parallel and never
+	//! depend on the event loop of the thread that issued them.
+	//!
+	struct NetworkPool
+	{
+		//! Protects the initialization and shutdown
+		QMutex mutex;
+
+		//! Requested number of threads
+		int threadCount = qBound(1, QThread::idealThreadCount(), 4);
+
+		//! The threads
+		QVector< QThread * > threads;
+
+		//! The network managers, one per thread
+		QVector< QNetworkAccessManager * > managers;
+	};
+
+	//!
+	//! Get the network pool.
+	//!
+	static NetworkPool & GetNetworkPool(void)
+	{
+		static NetworkPool pool;
+		return pool;
+	}
+
+	//!
+	//! Stop the network threads. This is registered as a post routine, so that
+	//! it's called when the application is destroyed.
+	//!
+	static void ShutdownNetworkPool(void)
+	{
+		NetworkPool & pool = GetNetworkPool();
+		QMutexLocker lock(&pool.mutex);
+		for (int i = 0; i < pool.threads.size(); ++i)
+		{
+			QNetworkAccessManager * manager = pool.managers[i];
+			QMetaObject::invokeMethod(manager, [manager] (void) { delete manager; }, Qt::BlockingQueuedConnection);
+			pool.threads[i]->quit();
+			pool.threads[i]->wait();
+			delete pool.threads[i];
+		}
+		pool.threads.clear();
+		pool.managers.clear();
+	}
+
+	//!
+	//! Run @p function in the thread of @p networkManager. If it's the calling thread,
+	//! the function is executed immediately.
+	//!
+	static void RunInThread(QNetworkAccessManager * networkManager, const std::function< void (void) > & function)
+	{
+		if (networkManager->thread() == QThread::currentThread())
+		{
+			function();
+		}
+		else
+		{
+			QMetaObject::invokeMethod(networkManager, function, Qt::QueuedConnection);
+		}
+	}
+
+	//!
+	//! Set the number of network threads used by requests that don't specify a network manager.
+	//! This must be called before the first request. Defaults to the ideal thread count,
+	//! limited to 4.
+	//!
+	void SetNetworkThreadCount(int count)
+	{
+		NetworkPool & pool = GetNetworkPool();
+		QMutexLocker lock(&pool.mutex);
+		Q_ASSERT(pool.threads.isEmpty() == true && "SetNetworkThreadCount must be called before the first request");
+		pool.threadCount = qMax(1, count);
+	}
+
+	//!
+	//! Get the pooled network manager used for requests to @p url. Requests to the same
+	//! host always use the same manager so that connections are reused. The manager lives
+	//! in a dedicated network thread, so it must only be used from that thread.
+	//!
+	QNetworkAccessManager * GetNetworkManager(const QUrl & url)
+	{
+		NetworkPool & pool = GetNetworkPool();
+		QMutexLocker lock(&pool.mutex);
+
+		// lazily start the threads
+		if (pool.threads.isEmpty() == true)
+		{
+			for (int i = 0; i < pool.threadCount; ++i)
+			{
+				QThread * thread = new QThread;
+				thread->setObjectName(QString("QtUtils Network %1").arg(i));
+				QNetworkAccessManager * manager = new QNetworkAccessManager;
+				manager->moveToThread(thread);
+				thread->start();
+				pool.threads.push_back(thread);
+				pool.managers.push_back(manager);
+			}
+			qAddPostRoutine(ShutdownNetworkPool);
+		}
+
+		return pool.managers[qHash(url.host()) % static_cast< uint >(pool.managers.size())];
+	}
+
+	//!
+	//! Cache of the permanent redirections.
+	//!
+	struct RedirectionCache
+	{
+		//! Protects the cache
+		QMutex mutex;
+
+		//! Target of the permanent redirections, indexed by source url
+		QCache< QString, QUrl > redirections{ 1024 };
+	};
+
+	//!
+	//! Get the permanent redirections cache.
+	//!
+	static RedirectionCache & GetRedirectionCache(void)
+	{
+		static RedirectionCache cache;
+		return cache;
+	}
+
+	//!
+	//! Returns true if @p reply is a redirection.
+	//!
+	static bool IsRedirection(QNetworkReply * reply)
+	{
+		switch (reply->attribute(QNetworkRequest::Attribute::HttpStatusCodeAttribute).toInt())
+		{
+			case 301:
+			case 302:
+			case 303:
+			case 307:
+			case 308:
+				return reply->hasRawHeader("Location");
+
+			default:
+				return false;
+		}
+	}
+
+	//!
+	//! Get the url that @p reply redirects to, or an empty url if it's not a redirection.
+	//! Permanent redirections (301 and 308) are recorded in the redirections cache.
+	//!
+	static QUrl GetRedirection(QNetworkReply * reply)
+	{
+		if (IsRedirection(reply) == false)
+		{
+			return QUrl();
+		}
+
+		const QUrl target = reply->url().resolved(QUrl::fromEncoded(reply->rawHeader("Location")));
+		const int statusCode = reply->attribute(QNetworkRequest::Attribute::HttpStatusCodeAttribute).toInt();
+		if (statusCode == 301 || statusCode == 308)
+		{
+			RedirectionCache & cache = GetRedirectionCache();
+			QMutexLocker lock(&cache.mutex);
+			cache.redirections.insert(reply->url().toString(QUrl::FullyEncoded), new QUrl(target));
+		}
+		return target;
+	}
+
+	//!
+	//! Follow the cached permanent redirections of @p url, if any.
+	//!
+	static QUrl ResolveRedirections(const QUrl & url)
+	{
+		RedirectionCache & cache = GetRedirectionCache();
+		QMutexLocker lock(&cache.mutex);
+		if (cache.redirections.isEmpty() == true)
+		{
+			return url;
+		}
+
+		// limit the number of hops in case of a redirection loop
+		QUrl result = url;
+		for (int i = 0; i < RequestOptions().maxRedirections; ++i)
+		{
+			const QUrl * target = cache.redirections.object(result.toString(QUrl::FullyEncoded));
+			if (target == nullptr)
+			{
+				break;
+			}
+			result = *target;
+		}
+		return result;
+	}
+
+	//!
+	//! Forget all the permanent redirections recorded so far.
+	//!
+	void ClearRedirectionCache(void)
+	{
+		RedirectionCache & cache = GetRedirectionCache();
+		QMutexLocker lock(&cache.mutex);
+		cache.redirections.clear();
+	}
+
+	//!
+	//! Per host connection statistics.
+	//!
+	struct ConnectionStats
+	{
+		//! Protects the statistics
+		QMutex mutex;
+
+		//! The statistics, indexed by host
+		QHash< QString, HostStats > hosts;
+	};
+
+	//!
+	//! Get the connection statistics.
+	//!
+	static ConnectionStats & GetConnectionStats(void)
+	{
+		static ConnectionStats stats;
+		return stats;
+	}
+
+	//!
+	//! Create the network request for @p url, configured with @p options.
+	//!
+	static QNetworkRequest CreateRequest(const QUrl & url, const RequestOptions & options)
+	{
+		QNetworkRequest request;
+		request.setUrl(url);
+		request.setAttribute(QNetworkRequest::Http2AllowedAttribute, options.http2);
+		return request;
+	}
+
+	//!
+	//! Timestamps of a request, used to build its RequestTiming.
+	//!
+	struct TimingData
+	{
+		//! The requested url
+		QString url;
+
+		//! Time at which the request was made
+		qint64 created = 0;
+
+		//! Time at which the first reply was sent, or -1
+		qint64 sent = -1;
+
+		//! Time at which the headers of the first reply were received, or -1
+		qint64 firstByte = -1;
+	};
+
+	//!
+	//! The timing callback.
+	//!
+	struct TimingHook
+	{
+		//! Protects the callback
+		QMutex mutex;
+
+		//! The callback
+		TimingCallback callback;
+	};
+
+	//! Set when a timing callback is set, to avoid any overhead otherwise
+	static std::atomic< bool > s_TimingEnabled{ false };
+
+	//!
+	//! Get the timing callback.
+	//!
+	static TimingHook & GetTimingHook(void)
+	{
+		static TimingHook hook;
+		return hook;
+	}
+
+	//!
+	//! Get the current time, in microseconds.
+	//!
+	static qint64 Now(void)
+	{
+		static QElapsedTimer timer = [] (void) { QElapsedTimer timer; timer.start(); return timer; }();
+		return timer.nsecsElapsed() / 1000;
+	}
+
+	//!
+	//! Start timing a request, if a timing callback is set. Returns nullptr otherwise.
+	//!
+	static std::shared_ptr< TimingData > StartTiming(const QString & url)
+	{
+		if (s_TimingEnabled == false)
+		{
+			return nullptr;
+		}
+		auto timing = std::make_shared< TimingData >();
+		timing->url		= url;
+		timing->created	= Now();
+		return timing;
+	}
+
+	//!
+	//! Call the timing callback for a finished request.
+	//!
+	static void ReportTiming(const std::shared_ptr< TimingData > & timing, qint64 bytes, QNetworkReply::NetworkError error)
+	{
+		if (timing == nullptr)
+		{
+			return;
+		}
+
+		TimingCallback callback;
+		{
+			TimingHook & hook = GetTimingHook();
+			QMutexLocker lock(&hook.mutex);
+			callback = hook.callback;
+		}
+		if (callback)
+		{
+			const qint64 now = Now();
+			RequestTiming result;
+			result.url			= timing->url;
+			result.queued		= (timing->sent == -1 ? now : timing->sent) - timing->created;
+			result.firstByte	= timing->firstByte == -1 ? -1 : timing->firstByte - timing->created;
+			result.total		= now - timing->created;
+			result.bytes		= bytes;
+			result.error		= error;
+			callback(result);
+		}
+	}
+
+	//!
+	//! Wrap @p success so that it reports the timing of the request first.
+	//!
+	static SuccessCallback WithTiming(const std::shared_ptr< TimingData > & timing, const SuccessCallback & success)
+	{
+		if (timing == nullptr)
+		{
+			return success;
+		}
+		return [timing, success] (QByteArray reply) {
+			ReportTiming(timing, reply.size(), QNetworkReply::NoError);
+			success(reply);
+		};
+	}
+
+	//!
+	//! Wrap @p success so that it reports the timing of the request first.
+	//!
+	static CompletionCallback WithTiming(const std::shared_ptr< TimingData > & timing, const CompletionCallback & success)
+	{
+		if (timing == nullptr)
+		{
+			return success;
+		}
+		return [timing, success] (qint64 size) {
+			ReportTiming(timing, size, QNetworkReply::NoError);
+			success(size);
+		};
+	}
+
+	//!
+	//! Wrap @p failure so that it reports the timing of the request first.
+	//!
+	static FailureCallback WithTiming(const std::shared_ptr< TimingData > & timing, const FailureCallback & failure)
+	{
+		if (timing == nullptr)
+		{
+			return failure;
+		}
+		return [timing, failure] (QNetworkReply::NetworkError error, QString errorString) {
+			ReportTiming(timing, 0, error);
+			failure(error, errorString);
+		};
+	}
+
+	//!
+	//! Set the callback called each time a request is finished, with its timings. This
+	//! can be used to monitor the requests in production: when no callback is set, the
+	//! requests are not timed at all. The callback is called from the network threads.
+	//!
+	//! Only the requests going to the network are timed: a request coalesced with an
+	//! identical one doesn't report anything.
+	//!
+	void SetTimingCallback(const TimingCallback & callback)
+	{
+		TimingHook & hook = GetTimingHook();
+		QMutexLocker lock(&hook.mutex);
+		hook.callback = callback;
+		s_TimingEnabled = bool(callback);
+	}
+
+	//!
+	//! Update the connection statistics of the host of @p reply when it's finished.
+	//! A TLS handshake means that a new connection was opened for this reply. If the
+	//! request is timed, also record when the reply was sent and started to arrive.
+	//!
+	static void TrackReply(QNetworkReply * reply, const std::shared_ptr< TimingData > & timing)
+	{
+		if (timing != nullptr)
+		{
+			timing->sent = timing->sent == -1 ? Now() : timing->sent;
+			QObject::connect(reply, &QNetworkReply::metaDataChanged, [timing] (void) {
+				timing->firstByte = timing->firstByte == -1 ? Now() : timing->firstByte;
+			});
+		}
+
+		const QString host = reply->url().host();
+#ifndef QT_NO_SSL
+		QObject::connect(reply, &QNetworkReply::encrypted, [host] (void) {
+			ConnectionStats & stats = GetConnectionStats();
+			QMutexLocker lock(&stats.mutex);
+			++stats.hosts[host].handshakes;
+		});
+#endif
+		QObject::connect(reply, &QNetworkReply::finished, [reply, host] (void) {
+			const bool http2 = reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool();
+			ConnectionStats & stats = GetConnectionStats();
+			QMutexLocker lock(&stats.mutex);
+			HostStats & hostStats = stats.hosts[host];
+			++hostStats.requests;
+			hostStats.http2Requests += http2 ? 1 : 0;
+		});
+	}
+
+	//!
+	//! Get the connection statistics of every host that was requested so far.
+	//!
+	QHash< QString, HostStats > GetHostStats(void)
+	{
+		ConnectionStats & stats = GetConnectionStats();
+		QMutexLocker lock(&stats.mutex);
+		return stats.hosts;
+	}
+
+	//!
+	//! Reset the connection statistics.
+	//!
+	void ResetHostStats(void)
+	{
+		ConnectionStats & stats = GetConnectionStats();
+		QMutexLocker lock(&stats.mutex);
+		stats.hosts.clear();
+	}
+
+	//!
+	//! Open a connection to the host of @p url ahead of time, so that the first request
+	//! to it doesn't pay for the DNS lookup and the TCP and TLS handshakes. The connection
+	//! is opened by the network manager that will be used by the requests to that host.
+	//!
+	//! @param url
+	//!		Url of the host, e.g. "https://api.some_host.com". The scheme defines if an
+	//!		encrypted connection is opened, and the port defaults to the scheme's one.
+	//!
+	//! @param networkManager
+	//!		Optional network manager to use. If not specified or nullptr, the pooled
+	//!		network manager of the host is used.
+	//!
+	void Preconnect(const QString & url, QNetworkAccessManager * networkManager)
+	{
+		const QUrl target(url);
+		if (networkManager == nullptr)
+		{
+			networkManager = GetNetworkManager(target);
+		}
+
+		{
+			ConnectionStats & stats = GetConnectionStats();
+			QMutexLocker lock(&stats.mutex);
+			++stats.hosts[target.host()].preconnections;
+		}
+
+		RunInThread(networkManager, [networkManager, target] (void) {
+#ifndef QT_NO_SSL
+			if (target.scheme() == "https")
+			{
+				// also negotiate HTTP/2, so that the connection can be used by requests allowing it
+				QSslConfiguration configuration = QSslConfiguration::defaultConfiguration();
+				configuration.setAllowedNextProtocols({ QSslConfiguration::ALPNProtocolHTTP2, QSslConfiguration::NextProtocolHttp1_1 });
+				networkManager->connectToHostEncrypted(target.host(), static_cast< quint16 >(target.port(443)), configuration);
+				return;
+			}
+#endif
+			networkManager->connectToHost(target.host(), static_cast< quint16 >(target.port(80)));
+		});
+	}
+
+	//!
+	//! Call @p failure with a TooManyRedirectsError.
+	//!
+	static void TooManyRedirections(QNetworkReply * reply, const FailureCallback & failure)
+	{
+		reply->deleteLater();
+		failure(QNetworkReply::TooManyRedirectsError, "Too many redirections");
+	}
+
+	//!
+	//! A single attempt at a request. Hedged and retried requests are made of several attempts.
+	//! Only used from the network thread.
+	//!
+	struct Attempt
+	{
+		//! The options of the request
+		RequestOptions options;
+
+		//! The deadline of the whole request (none by default)
+		QDeadlineTimer deadline{ QDeadlineTimer::Forever };
+
+		//! The current reply, if any
+		QPointer< QNetworkReply > reply;
+
+		//! Set when another attempt won
+		bool canceled = false;
+
+		//! Set when the deadline expired
+		bool timedOut = false;
+
+		//! Started when the attempt was sent
+		QElapsedTimer timer;
+
+		//! Timestamps of the request, if it's timed
+		std::shared_ptr< TimingData > timing;
+	};
+
+	//!
+	//! A request, as a race between its attempts. Only used from the network thread.
+	//!
+	struct Race
+	{
+		QNetworkAccessManager * networkManager;
+		QUrl url;
+		RequestOptions options;
+		QDeadlineTimer deadline;
+		SuccessCallback success;
+		FailureCallback failure;
+
+		//! The attempts of the current round
+		QVector< std::shared_ptr< Attempt > > attempts;
+
+		//! Number of retries so far
+		int retry = 0;
+
+		//! Number of attempts of the current round still running
+		int pending = 0;
+
+		//! Set when the request succeeded or definitely failed
+		bool done = false;
+
+		//! Timestamps of the request, if it's timed
+		std::shared_ptr< TimingData > timing;
+	};
+
+	//!
+	//! Recent latencies of the successful requests, per host. Used to compute the hedging delays.
+	//!
+	struct Latencies
+	{
+		//! Protects the latencies
+		QMutex mutex;
+
+		//! The latencies, in milliseconds, in a ring buffer per host
+		QHash< QString, QVector< qint64 > > hosts;
+
+		//! Next slot of each ring buffer
+		QHash< QString, int > next;
+	};
+
+	//! Number of latencies kept per host
+	static constexpr int s_LatencyCount = 64;
+
+	//! Minimum number of latencies before using them to compute the hedging delay
+	static constexpr int s_MinLatencyCount = 8;
+
+	//! Hedging delay used until enough latencies are known, in milliseconds
+	static constexpr qint64 s_DefaultHedgeDelay = 100;
+
+	//!
+	//! Get the latencies.
+	//!
+	static Latencies & GetLatencies(void)
+	{
+		static Latencies latencies;
+		return latencies;
+	}
+
+	//!
+	//! Record the latency of a successful request to @p host.
+	//!
+	static void RecordLatency(const QString & host, qint64 latency)
+	{
+		Latencies & latencies = GetLatencies();
+		QMutexLocker lock(&latencies.mutex);
+		QVector< qint64 > & samples = latencies.hosts[host];
+		if (samples.size() < s_LatencyCount)
+		{
+			samples.push_back(latency);
+		}
+		else
+		{
+			int & next = latencies.next[host];
+			samples[next] = latency;
+			next = (next + 1) % s_LatencyCount;
+		}
+	}
+
+	//!
+	//! Get the hedging delay for @p host: the given percentile of its recent latencies.
+	//!
+	static qint64 GetHedgeDelay(const QString & host, double percentile)
+	{
+		Latencies & latencies = GetLatencies();
+		QMutexLocker lock(&latencies.mutex);
+		QVector< qint64 > samples = latencies.hosts.value(host);
+		lock.unlock();
+
+		if (samples.size() < s_MinLatencyCount)
+		{
+			return s_DefaultHedgeDelay;
+		}
+		std::sort(samples.begin(), samples.end());
+		return samples[qBound(0, static_cast< int >(percentile * samples.size()), samples.size() - 1)];
+	}
+
+	//!
+	//! Returns true if a request that failed with @p error can be retried.
+	//!
+	static bool IsTransient(QNetworkReply::NetworkError error)
+	{
+		switch (error)
+		{
+			case QNetworkReply::ConnectionRefusedError:
+			case QNetworkReply::RemoteHostClosedError:
+			case QNetworkReply::TemporaryNetworkFailureError:
+			case QNetworkReply::NetworkSessionFailedError:
+			case QNetworkReply::ProxyConnectionClosedError:
+			case QNetworkReply::ProxyTimeoutError:
+			case QNetworkReply::UnknownNetworkError:
+			case QNetworkReply::InternalServerError:
+			case QNetworkReply::ServiceUnavailableError:
+			case QNetworkReply::UnknownServerError:
+				return true;
+
+			default:
+				return false;
+		}
+	}
+
+	//!
+	//! Abort @p reply when the deadline of @p attempt expires.
+	//!
+	static void StartTimeout(QNetworkReply * reply, const std::shared_ptr< Attempt > & attempt)
+	{
+		if (attempt->deadline.isForever() == false)
+		{
+			QTimer * timer = new QTimer(reply);
+			timer->setSingleShot(true);
+			QObject::connect(timer, &QTimer::timeout, reply, [attempt, reply] (void) {
+				attempt->timedOut = true;
+				reply->abort();
+			});
+			timer->start(static_cast< int >(qMax(qint64(0), attempt->deadline.remainingTime())));
+		}
+	}
+
+	// forward declarations
+	static void StartRound(const std::shared_ptr< Race > & race);
+	static void Get(QNetworkAccessManager * networkManager, const QUrl & requestedUrl, const std::shared_ptr< Attempt > & attempt, int redirections, const SuccessCallback & success, const FailureCallback & failure);
+
+	//!
+	//! Start a new attempt of @p race.
+	//!
+	static void StartAttempt(const std::shared_ptr< Race > & race)
+	{
+		auto attempt = std::make_shared< Attempt >();
+		attempt->options = race->options;
+		attempt->deadline = race->deadline;
+		attempt->timer.start();
+		attempt->timing = race->timing;
+		race->attempts.push_back(attempt);
+		++race->pending;
+
+		Get(race->networkManager, race->url, attempt, qMax(0, race->options.maxRedirections),
+			[race, attempt] (QByteArray reply) {
+				--race->pending;
+				if (race->done == true)
+				{
+					return;
+				}
+				race->done = true;
+				RecordLatency(race->url.host(), attempt->timer.elapsed());
+
+				// cancel the other attempts
+				for (const auto & other : race->attempts)
+				{
+					if (other != attempt)
+					{
+						other->canceled = true;
+						if (other->reply != nullptr)
+						{
+							other->reply->abort();
+						}
+					}
+				}
+				race->success(reply);
+			},
+			[race] (QNetworkReply::NetworkError error, QString errorString) {
+				// wait for the other attempts of the round, if any
+				if (--race->pending > 0 || race->done == true)
+				{
+					return;
+				}
+
+				// retry transient errors, with a jittered exponential backoff
+				if (race->retry < race->options.retries && IsTransient(error) == true && race->deadline.hasExpired() == false)
+				{
+					const qint64 delay = qint64(race->options.retryDelay) << race->retry;
+					const qint64 jittered = delay / 2 + QRandomGenerator::global()->bounded(delay + 1);
+					++race->retry;
+					QTimer::singleShot(static_cast< int >(qMin(jittered, race->deadline.isForever() ? jittered : race->deadline.remainingTime())), race->networkManager, [race] (void) {
+						StartRound(race);
+					});
+					return;
+				}
+
+				race->done = true;
+				race->failure(error, errorString);
+			}
+		);
+	}
+
+	//!
+	//! Start a round of attempts of @p race: send the request, and if hedging is enabled, send
+	//! a duplicate if no reply arrived after the hedging delay.
+	//!
+	static void StartRound(const std::shared_ptr< Race > & race)
+	{
+		race->attempts.clear();
+		race->pending = 0;
+		StartAttempt(race);
+
+		if (race->options.hedge == true)
+		{
+			const int retry = race->retry;
+			const qint64 delay = GetHedgeDelay(race->url.host(), race->options.hedgePercentile);
+			QTimer::singleShot(static_cast< int >(delay), race->networkManager, [race, retry] (void) {
+				if (race->done == false && race->retry == retry && race->pending > 0)
+				{
+					StartAttempt(race);
+				}
+			});
+		}
+	}
+
+	//!
+	//! Execute a request, applying the hedging and retry policies of @p options. This must be
+	//! called from the thread of @p networkManager, and the callbacks are called from that
+	//! thread too.
+	//!
+	static void Execute(QNetworkAccessManager * networkManager, const QUrl & url, const RequestOptions & options, const std::shared_ptr< TimingData > & timing, const SuccessCallback & success, const FailureCallback & failure)
+	{
+		auto race = std::make_shared< Race >();
+		race->networkManager	= networkManager;
+		race->url				= url;
+		race->options			= options;
+		race->deadline			= QDeadlineTimer(options.timeout < 0 ? -1 : options.timeout);
+		race->success			= success;
+		race->failure			= failure;
+		race->timing			= timing;
+		StartRound(race);
+	}
+
+	//!
+	//! Send a GET request and call either @p success or @p failure when it's finished.
+	//! This must be called from the thread of @p networkManager, and the callbacks are
+	//! called from that thread too.
+	//!
+	//! @param attempt
+	//!		The attempt this request belongs to. The request is aborted if the attempt's
+	//!		deadline expires, and if the attempt is canceled no callback is called.
+	//!
+	//! @param redirections
+	//!		Maximum number of redirections to follow.
+	//!
+	static void Get(QNetworkAccessManager * networkManager, const QUrl & requestedUrl, const std::shared_ptr< Attempt > & attempt, int redirections, const SuccessCallback & success, const FailureCallback & failure)
+	{
+		Q_ASSERT(networkManager->thread() == QThread::currentThread());
+
+		// skip the known permanent redirections
+		const QUrl url = ResolveRedirections(requestedUrl);
+
+		// prepare the request
+		QNetworkRequest request = CreateRequest(url, attempt->options);
+
+		// check the cache. Fresh entries are served directly, stale ones are revalidated
+		auto cached = std::make_shared< HttpCache::Entry >();
+		const bool useCache = HttpCache::IsEnabled();
+		const bool hasCached = useCache == true && HttpCache::Find(url, *cached) == true;
+		if (hasCached == true)
+		{
+			if (HttpCache::IsFresh(*cached) == true)
+			{
+				HttpCache::Hit(cached->data.size(), false);
+				QMetaObject::invokeMethod(networkManager, [=] (void) {
+					if (attempt->canceled == false)
+					{
+						success(cached->data);
+					}
+				}, Qt::QueuedConnection);
+				return;
+			}
+			HttpCache::AddValidators(*cached, request);
+		}
+
+		// send
+		QNetworkReply * reply = networkManager->get(request);
+		attempt->reply = reply;
+		TrackReply(reply, attempt->timing);
+
+		StartTimeout(reply, attempt);
+
+		QObject::connect(reply, &QNetworkReply::finished, [=] (void) {
+			QNetworkReply::NetworkError error = reply->error();
+
+			// another attempt won
+			if (attempt->canceled == true)
+			{
+				reply->deleteLater();
+				return;
+			}
+
+			// redirect
+			const QUrl redirection = GetRedirection(reply);
+			if (redirection.isEmpty() == false)
+			{
+				if (redirections <= 0)
+				{
+					TooManyRedirections(reply, failure);
+					return;
+				}
+				reply->deleteLater();
+				Get(networkManager, redirection, attempt, redirections - 1, success, failure);
+				return;
+			}
+
+			if (attempt->timedOut == true)
+			{
+				reply->deleteLater();
+				failure(QNetworkReply::TimeoutError, "Request timed out");
+			}
+			else if (error != QNetworkReply::NoError)
+			{
+				QString errorString = reply->errorString();
+				reply->deleteLater();
+				failure(error, errorString);
+			}
+			else if (hasCached == true && HttpCache::IsNotModified(reply) == true)
+			{
+				// revalidated, serve from the cache
+				if (HttpCache::Update(reply, *cached) == true)
+				{
+					HttpCache::Insert(url, *cached);
+				}
+				HttpCache::Hit(cached->data.size(), true);
+				reply->deleteLater();
+				success(cached->data);
+			}
+			else
+			{
+				QByteArray result = reply->readAll();
+				if (useCache == true)
+				{
+					HttpCache::Miss(result.size());
+					HttpCache::Entry entry;
+					entry.data = result;
+					if (HttpCache::Update(reply, entry) == true)
+					{
+						HttpCache::Insert(url, entry);
+					}
+					else if (hasCached == true)
+					{
+						HttpCache::Remove(url);
+					}
+				}
+				reply->deleteLater();
+				success(result);
+			}
+		});
+	}
+
+	//!
+	//! Send a GET request and call @p chunk each time some data is received. When the request is
+	//! finished, call either @p success or @p failure. This must be called from the thread of
+	//! @p networkManager, and the callbacks are called from that thread too.
+	//!
+	//! @param attempt
+	//!		The attempt this request belongs to. The request is aborted if the attempt's
+	//!		deadline expires, which is kept when following redirections.
+	//!
+	//! @param bufferSize
+	//!		Maximum size of the chunks, also used as the read buffer size of the reply.
+	//!
+	static void Stream(QNetworkAccessManager * networkManager, const QUrl & requestedUrl, const std::shared_ptr< Attempt > & attempt, qint64 bufferSize, int redirections, const ChunkCallback & chunk, const CompletionCallback & success, const FailureCallback & failure)
+	{
+		Q_ASSERT(networkManager->thread() == QThread::currentThread());
+
+		// skip the known permanent redirections
+		const QUrl url = ResolveRedirections(requestedUrl);
+
+		// prepare the request
+		QNetworkRequest request = CreateRequest(url, attempt->options);
+
+		// send
+		QNetworkReply * reply = networkManager->get(request);
+		reply->setReadBufferSize(bufferSize);
+		attempt->reply = reply;
+		TrackReply(reply, attempt->timing);
+		StartTimeout(reply, attempt);
+
+		// forward the data as soon as it arrives
+		auto received = std::make_shared< qint64 >(0);
+		QObject::connect(reply, &QNetworkReply::readyRead, [=] (void) {
+			if (IsRedirection(reply) == true)
+			{
+				reply->skip(reply->bytesAvailable());
+				return;
+			}
+			while (reply->bytesAvailable() > 0)
+			{
+				const QByteArray data = reply->read(bufferSize);
+				*received += data.size();
+				if (chunk(data) == false)
+				{
+					reply->abort();
+					return;
+				}
+			}
+		});
+
+		QObject::connect(reply, &QNetworkReply::finished, [=] (void) {
+			QNetworkReply::NetworkError error = reply->error();
+
+			// redirect
+			const QUrl redirection = GetRedirection(reply);
+			if (redirection.isEmpty() == false)
+			{
+				if (redirections <= 0)
+				{
+					TooManyRedirections(reply, failure);
+					return;
+				}
+				reply->deleteLater();
+				Stream(networkManager, redirection, attempt, bufferSize, redirections - 1, chunk, success, failure);
+				return;
+			}
+
+			if (attempt->timedOut == true)
+			{
+				reply->deleteLater();
+				failure(QNetworkReply::TimeoutError, "Request timed out");
+			}
+			else if (error != QNetworkReply::NoError)
+			{
+				QString errorString = reply->errorString();
+				reply->deleteLater();
+				failure(error, errorString);
+			}
+			else
+			{
+				// flush what's left
+				while (reply->bytesAvailable() > 0)
+				{
+					const QByteArray data = reply->read(bufferSize);
+					*received += data.size();
+					if (chunk(data) == false)
+					{
+						reply->deleteLater();
+						failure(QNetworkReply::OperationCanceledError, "Operation canceled");
+						return;
+					}
+				}
+				reply->deleteLater();
+				success(*received);
+			}
+		});
+	}
+
+	//!
+	//! Create the device used to upload the file or device of @p body. Files are memory mapped and
+	//! wrapped in a buffer, which the network stack reads in place instead of copying it.
+	//!
+	//! @param position
+	//!		Position at which the upload of a non-sequential device starts.
+	//!
+	//! @param owner
+	//!		Parent of the objects created to read the body.
+	//!
+	//! @returns
+	//!		The device, or nullptr on error, in which case @p errorString is set.
+	//!
+	static QIODevice * OpenBody(const RequestBody & body, qint64 position, QObject * owner, QString & errorString)
+	{
+		if (body.device != nullptr)
+		{
+			if (body.device->isSequential() == false && body.device->seek(position) == false)
+			{
+				errorString = body.device->errorString();
+				return nullptr;
+			}
+			return body.device;
+		}
+
+		QFile * file = new QFile(body.filename, owner);
+		if (file->open(QIODevice::ReadOnly) == false)
+		{
+			errorString = file->errorString();
+			return nullptr;
+		}
+
+		// a QByteArray can't hold more than 2GB: bigger files (and the ones that can't be mapped)
+		// are read by chunks by the network stack, which doesn't need more memory either.
+		const qint64 size = file->size();
+		uchar * data = size > 0 && size <= std::numeric_limits< int >::max() ? file->map(0, size) : nullptr;
+		if (data == nullptr)
+		{
+			return file;
+		}
+		QBuffer * buffer = new QBuffer(owner);
+		buffer->setData(QByteArray::fromRawData(reinterpret_cast< const char * >(data), static_cast< int >(size)));
+		buffer->open(QIODevice::ReadOnly);
+		return buffer;
+	}
+
+	//!
+	//! Send @p body with a @p method (POST or PUT) request and call @p chunk each time some
+	//! data of the reply is received. When the request is finished, call either @p success or
+	//! @p failure. This must be called from the thread of @p networkManager, and the callbacks
+	//! are called from that thread too.
+	//!
+	//! 301, 302 and 303 redirections are followed with a GET request, like browsers do, and 307
+	//! and 308 ones by sending the body again, which isn't possible for sequential devices.
+	//! In both cases the deadline of @p attempt still applies.
+	//!
+	//! @param position
+	//!		Position at which the upload of a non-sequential device starts.
+	//!
+	static void Upload(QNetworkAccessManager * networkManager, const QByteArray & method, const QUrl & requestedUrl, const RequestBody & body, qint64 position, const std::shared_ptr< Attempt > & attempt, qint64 bufferSize, int redirections, const ChunkCallback & chunk, const CompletionCallback & success, const FailureCallback & failure)
+	{
+		Q_ASSERT(networkManager->thread() == QThread::currentThread());
+
+		// skip the known permanent redirections
+		const QUrl url = ResolveRedirections(requestedUrl);
+
+		// prepare the request
+		QNetworkRequest request = CreateRequest(url, attempt->options);
+		request.setHeader(QNetworkRequest::ContentTypeHeader, body.contentType);
+
+		// send. Data is shared with the network stack, never copied
+		QNetworkReply * reply = nullptr;
+		if (body.device == nullptr && body.filename.isEmpty() == true)
+		{
+			reply = networkManager->sendCustomRequest(request, method, body.data);
+		}
+		else
+		{
+			QString errorString;
+			QObject * owner = new QObject();
+			QIODevice * device = OpenBody(body, position, owner, errorString);
+			if (device == nullptr)
+			{
+				delete owner;
+				failure(QNetworkReply::UnknownContentError, errorString);
+				return;
+			}
+			if (body.device != nullptr && body.size >= 0)
+			{
+				// without it, sequential devices are entirely buffered before being sent
+				request.setHeader(QNetworkRequest::ContentLengthHeader, body.size);
+			}
+			reply = networkManager->sendCustomRequest(request, method, device);
+			owner->setParent(reply);
+		}
+		reply->setReadBufferSize(bufferSize);
+		attempt->reply = reply;
+		TrackReply(reply, attempt->timing);
+		StartTimeout(reply, attempt);
+
+		// progress
+		if (body.progress)
+		{
+			QObject::connect(reply, &QNetworkReply::uploadProgress, [progress = body.progress] (qint64 sent, qint64 total) {
+				progress(sent, total);
+			});
+		}
+
+		// forward the data as soon as it arrives
+		auto received = std::make_shared< qint64 >(0);
+		QObject::connect(reply, &QNetworkReply::readyRead, [=] (void) {
+			if (IsRedirection(reply) == true)
+			{
+				reply->skip(reply->bytesAvailable());
+				return;
+			}
+			while (reply->bytesAvailable() > 0)
+			{
+				const QByteArray data = reply->read(bufferSize);
+				*received += data.size();
+				if (chunk(data) == false)
+				{
+					reply->abort();
+					return;
+				}
+			}
+		});
+
+		QObject::connect(reply, &QNetworkReply::finished, [=] (void) {
+			QNetworkReply::NetworkError error = reply->error();
+
+			// redirect
+			const QUrl redirection = GetRedirection(reply);
+			if (redirection.isEmpty() == false)
+			{
+				if (redirections <= 0)
+				{
+					TooManyRedirections(reply, failure);
+					return;
+				}
+				const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+				reply->deleteLater();
+				if (status != 307 && status != 308)
+				{
+					Stream(networkManager, redirection, attempt, bufferSize, redirections - 1, chunk, success, failure);
+				}
+				else if (body.device != nullptr && body.device->isSequential() == true)
+				{
+					failure(QNetworkReply::ContentReSendError, "The body can't be sent again to follow the redirection");
+				}
+				else
+				{
+					Upload(networkManager, method, redirection, body, position, attempt, bufferSize, redirections - 1, chunk, success, failure);
+				}
+				return;
+			}
+
+			if (attempt->timedOut == true)
+			{
+				reply->deleteLater();
+				failure(QNetworkReply::TimeoutError, "Request timed out");
+			}
+			else if (error != QNetworkReply::NoError)
+			{
+				QString errorString = reply->errorString();
+				reply->deleteLater();
+				failure(error, errorString);
+			}
+			else
+			{
+				// flush what's left
+				while (reply->bytesAvailable() > 0)
+				{
+					const QByteArray data = reply->read(bufferSize);
+					*received += data.size();
+					if (chunk(data) == false)
+					{
+						reply->deleteLater();
+						failure(QNetworkReply::OperationCanceledError, "Operation canceled");
+						return;
+					}
+				}
+				reply->deleteLater();
+				success(*received);
+			}
+		});
+	}
 
 	//!
-	//! Synchronously request a url.
+	//! Send an upload request from any thread, streaming the reply.
 	//!
-	//! @param url
-	//!		The url to request.
+	static void SendUpload(const QByteArray & method, const QString & url, const RequestBody & body, const RequestOptions & options, qint64 bufferSize, const ChunkCallback & chunk, const CompletionCallback & success, const FailureCallback & failure)
+	{
+		// check the manager
+		QNetworkAccessManager * networkManager = options.networkManager;
+		if (networkManager == nullptr)
+		{
+			networkManager = GetNetworkManager(QUrl(url));
+		}
+
+		// send
+		bufferSize = qMax(qint64(1), bufferSize);
+		auto timing = StartTiming(url);
+		RunInThread(networkManager, [=] (void) {
+			auto attempt = std::make_shared< Attempt >();
+			attempt->timing = timing;
+			attempt->options = options;
+			attempt->deadline = QDeadlineTimer(options.timeout < 0 ? -1 : options.timeout);
+			const qint64 position = body.device != nullptr ? body.device->pos() : 0;
+			Upload(networkManager, method, QUrl(url), body, position, attempt, bufferSize, qMax(0, options.maxRedirections), chunk, WithTiming(timing, success), WithTiming(timing, failure));
+		});
+	}
+
 	//!
-	//! @param networkManager
-	//!		Optional network manager to use. If not specified or nullptr, a global one defined in the
-	//!		QtUtils library is used.
+	//! Send an upload request from any thread, buffering the reply.
 	//!
-	//! @returns
-	//!		The reply or an empty array.
+	static void SendUpload(const QByteArray & method, const QString & url, const RequestBody & body, const RequestOptions & options, const SuccessCallback & success, const FailureCallback & failure)
+	{
+		auto reply = std::make_shared< QByteArray >();
+		SendUpload(method, url, body, options, 64 * 1024,
+			[reply] (const QByteArray & chunk) { reply->append(chunk); return true; },
+			[reply, success] (qint64) { success(*reply); },
+			failure
+		);
+	}
+
+	//!
+	//! Requests currently in flight, used to coalesce identical requests.
+	//!
+	struct InFlightRequests
+	{
+		//! Protects the data
+		QMutex mutex;
+
+		//! Callbacks of the waiting requests, indexed by network manager and GetInFlightKey
+		QHash< QPair< QNetworkAccessManager *, QString >, QVector< QPair< SuccessCallback, FailureCallback > > > requests;
+
+		//! Number of requests that were merged into an in-flight one
+		qint64 merged = 0;
+	};
+
+	//!
+	//! Get the in-flight requests.
+	//!
+	static InFlightRequests & GetInFlightRequests(void)
+	{
+		static InFlightRequests inFlight;
+		return inFlight;
+	}
+
 	//!
-	QByteArray RequestUrl(const QString & url, QNetworkAccessManager * networkManager)
+	//! Get the key identifying a request in the in-flight requests: the url, and the options
+	//! which change the behavior of the request, so that only requests that would behave the
+	//! same way are coalesced (e.g. a request with a timeout never waits on one without)
+	//!
+	static QString GetInFlightKey(const QString & url, const RequestOptions & options)
+	{
+		return QString("%1|%2|%3|%4|%5|%6|%7|%8")
+			.arg(options.timeout)
+			.arg(options.maxRedirections)
+			.arg(options.http2 == true ? 1 : 0)
+			.arg(options.hedge == true ? 1 : 0)
+			.arg(options.hedgePercentile)
+			.arg(options.retries)
+			.arg(options.retryDelay)
+			.arg(url);
+	}
+
+	//!
+	//! Send a request with the given options from any thread. Unless disabled in
+	//! @p options, identical concurrent requests are coalesced: only the first one
+	//! goes to the network, and all callbacks receive the same result.
+	//!
+	static void Send(const QString & url, const RequestOptions & options, const SuccessCallback & success, const FailureCallback & failure)
 	{
 		// check the manager
+		QNetworkAccessManager * networkManager = options.networkManager;
 		if (networkManager == nullptr)
 		{
-			networkManager = &s_NetworkManager;
+			networkManager = GetNetworkManager(QUrl(url));
+		}
+
+		// no deduplication, just send
+		if (options.deduplicate == false)
+		{
+			auto timing = StartTiming(url);
+			RunInThread(networkManager, [=] (void) {
+				Execute(networkManager, QUrl(url), options, timing, WithTiming(timing, success), WithTiming(timing, failure));
+			});
+			return;
 		}
 
-		// to handle http redirections
-		QString address = url;
-		for (int i = 0; i < 2; ++i)
+		// check if the same request is already in flight
+		const auto key = qMakePair(networkManager, GetInFlightKey(url, options));
+		InFlightRequests & inFlight = GetInFlightRequests();
 		{
-			// prepare the request
-			QNetworkRequest request;
-			request.setUrl(QUrl(address));
+			QMutexLocker lock(&inFlight.mutex);
+			auto request = inFlight.requests.find(key);
+			if (request != inFlight.requests.end())
+			{
+				request->push_back(qMakePair(success, failure));
+				++inFlight.merged;
+				return;
+			}
+			inFlight.requests.insert(key, { qMakePair(success, failure) });
+		}
+
+		// send, and dispatch the result to every waiting request
+		auto takeWaiting = [key] (void) {
+			InFlightRequests & inFlight = GetInFlightRequests();
+			QMutexLocker lock(&inFlight.mutex);
+			return inFlight.requests.take(key);
+		};
+		auto timing = StartTiming(url);
+		RunInThread(networkManager, [=] (void) {
+			Execute(networkManager, QUrl(url), options, timing,
+				WithTiming(timing, SuccessCallback([takeWaiting] (QByteArray reply) {
+					for (const auto & waiting : takeWaiting())
+					{
+						waiting.first(reply);
+					}
+				})),
+				WithTiming(timing, FailureCallback([takeWaiting] (QNetworkReply::NetworkError error, QString errorString) {
+					for (const auto & waiting : takeWaiting())
+					{
+						waiting.second(error, errorString);
+					}
+				}))
+			);
+		});
+	}
 
-			// send
-			QNetworkReply * reply = networkManager->get(request);
+	//!
+	//! Get the number of requests that were merged into identical in-flight requests
+	//! instead of going to the network.
+	//!
+	qint64 GetDeduplicatedRequestCount(void)
+	{
+		InFlightRequests & inFlight = GetInFlightRequests();
+		QMutexLocker lock(&inFlight.mutex);
+		return inFlight.merged;
+	}
 
-			// wait for the reply
-			QEventLoop loop;
-			while (reply->isFinished() == false)
+	//!
+	//! Start a request by calling @p send with the callbacks to use, then sleep until it's
+	//! finished. This can be called from any thread.
+	//!
+	//! @returns
+	//!		The reply or an empty array (on error or timeout)
+	//!
+	static QByteArray Wait(const QString & url, const RequestOptions & options, const std::function< void (const SuccessCallback &, const FailureCallback &) > & send)
+	{
+		// state shared with the network thread
+		struct State
+		{
+			QMutex mutex;
+			QWaitCondition condition;
+			QEventLoop * loop = nullptr;
+			bool done = false;
+			QByteArray result;
+		};
+		auto state = std::make_shared< State >();
+		auto finish = [state] (const QByteArray & result) {
+			QMutexLocker lock(&state->mutex);
+			state->result = result;
+			state->done = true;
+			state->condition.wakeAll();
+			if (state->loop != nullptr)
 			{
-				loop.processEvents();
+				state->loop->quit();
 			}
+		};
+
+		// send
+		const QNetworkAccessManager * networkManager = options.networkManager != nullptr ? options.networkManager : GetNetworkManager(QUrl(url));
+		const bool sameThread = networkManager->thread() == QThread::currentThread();
+		const QDeadlineTimer deadline(options.timeout < 0 ? -1 : options.timeout);
+		send(
+			[finish] (QByteArray reply) { finish(reply); },
+			[finish] (QNetworkReply::NetworkError, QString) { finish(QByteArray()); }
+		);
 
-			if (reply->error() != QNetworkReply::NoError)
+		// wait. If the manager lives in this thread we need to process its events, so sleep
+		// in a local event loop, otherwise just sleep until the network thread wakes us up.
+		// In both cases the request itself is aborted when the deadline expires.
+		QMutexLocker lock(&state->mutex);
+		if (sameThread == true)
+		{
+			QEventLoop loop;
+			QTimer timer;
+			timer.setSingleShot(true);
+			QObject::connect(&timer, &QTimer::timeout, &loop, &QEventLoop::quit);
+			while (state->done == false)
 			{
-				reply->deleteLater();
-				return QByteArray();
+				if (deadline.hasExpired() == true)
+				{
+					return QByteArray();
+				}
+				state->loop = &loop;
+				lock.unlock();
+				if (deadline.isForever() == false)
+				{
+					timer.start(static_cast< int >(qMax< qint64 >(0, deadline.remainingTime())));
+				}
+				loop.exec();
+				lock.relock();
+				state->loop = nullptr;
 			}
-			else
+		}
+		else
+		{
+			while (state->done == false)
 			{
-				QVariant statusCode = reply->attribute(QNetworkRequest::Attribute::HttpStatusCodeAttribute);
-				if (statusCode.isValid())
+				if (state->condition.wait(&state->mutex, deadline) == false)
 				{
-					// redirect
-					if (statusCode.toInt() == 301)
-					{
-						address = reply->header(QNetworkRequest::KnownHeaders::LocationHeader).toString();
-						reply->deleteLater();
-						continue;
-					}
+					return QByteArray();
 				}
-
-				QByteArray result = reply->readAll();
-				reply->deleteLater();
-				return result;
 			}
 		}
-
-		return QByteArray();
+		return state->result;
 	}
 
 	//!
-	//! Asynchronously request a url.
+	//! Synchronously request a url. This can be called from any thread: the calling
+	//! thread sleeps until the request is finished.
+	//!
+	//! @param url
+	//!		The url to request.
 	//!
 	//! @param networkManager
-	//!		The network manager to use for this request
+	//!		Optional network manager to use. If not specified or nullptr, one of the pooled
+	//!		network managers defined in the QtUtils library is used.
+	//!
+	//! @param timeout
+	//!		Optional timeout in milliseconds for the whole request (redirections included)
+	//!		A negative value means no timeout.
+	//!
+	//! @returns
+	//!		The reply or an empty array (on error or timeout)
+	//!
+	QByteArray RequestUrl(const QString & url, QNetworkAccessManager * networkManager, int timeout)
+	{
+		RequestOptions options;
+		options.networkManager	= networkManager;
+		options.timeout			= timeout;
+		return RequestUrl(url, options);
+	}
+
+	//!
+	//! Synchronously request a url with the given @p options. See the other overload
+	//! for more information.
+	//!
+	QByteArray RequestUrl(const QString & url, const RequestOptions & options)
+	{
+		return Wait(url, options, [&] (const SuccessCallback & success, const FailureCallback & failure) {
+			Send(url, options, success, failure);
+		});
+	}
+
+	//!
+	//! Asynchronously request a url.
 	//!
 	//! @param url
 	//!		The url to request.
@@ -96,50 +1495,313 @@ QT_UTILS_NAMESPACE_BEGIN
 	//!		A function that will be called if the request failed.
 	//!
 	//! @param networkManager
-	//!		Optional network manager to use. If not specified or nullptr, a global one defined in the
-	//!		QtUtils library is used.
+	//!		Optional network manager to use. If not specified or nullptr, one of the pooled
+	//!		network managers defined in the QtUtils library is used, and the callbacks are
+	//!		called from its network thread. Otherwise they're called from the thread of the
+	//!		given manager.
 	//!
 	void RequestUrl(const QString & url, const SuccessCallback & success, const FailureCallback & failure, QNetworkAccessManager * networkManager)
+	{
+		RequestOptions options;
+		options.networkManager = networkManager;
+		RequestUrl(url, success, failure, options);
+	}
+
+	//!
+	//! Asynchronously request a url with the given @p options. See the other overload
+	//! for more information.
+	//!
+	void RequestUrl(const QString & url, const SuccessCallback & success, const FailureCallback & failure, const RequestOptions & options)
+	{
+		Send(url, options, success, failure);
+	}
+
+	//!
+	//! Asynchronously request a url, streaming the data as it arrives instead of
+	//! buffering the whole reply. At most @p bufferSize bytes are buffered: while
+	//! the @p chunk callback is running, nothing more is read from the network.
+	//!
+	//! @param url
+	//!		The url to request.
+	//!
+	//! @param chunk
+	//!		A function called for each received chunk of data. Return false from
+	//!		it to abort the request, in which case @p failure is called.
+	//!
+	//! @param success
+	//!		A function called when the whole reply was received, with its size.
+	//!
+	//! @param failure
+	//!		A function called if the request failed.
+	//!
+	//! @param bufferSize
+	//!		Maximum size of the chunks, in bytes.
+	//!
+	//! @param networkManager
+	//!		Optional network manager to use. If not specified or nullptr, one of the pooled
+	//!		network managers defined in the QtUtils library is used.
+	//!
+	//! @note
+	//!		The callbacks are called from the thread of the network manager. Since that
+	//!		thread also handles other requests, avoid doing heavy work in @p chunk.
+	//!
+	void StreamUrl(const QString & url, const ChunkCallback & chunk, const CompletionCallback & success, const FailureCallback & failure, qint64 bufferSize, QNetworkAccessManager * networkManager)
+	{
+		RequestOptions options;
+		options.networkManager = networkManager;
+		StreamUrl(url, chunk, success, failure, options, bufferSize);
+	}
+
+	//!
+	//! Asynchronously stream a url with the given @p options. See the other overload for
+	//! more information.
+	//!
+	//! @note
+	//!		Streamed requests are never deduplicated, cached, hedged nor retried: only the
+	//!		network manager, timeout, redirections and HTTP/2 options apply.
+	//!
+	void StreamUrl(const QString & url, const ChunkCallback & chunk, const CompletionCallback & success, const FailureCallback & failure, const RequestOptions & options, qint64 bufferSize)
 	{
 		// check the manager
+		QNetworkAccessManager * networkManager = options.networkManager;
 		if (networkManager == nullptr)
 		{
-			networkManager = &s_NetworkManager;
+			networkManager = GetNetworkManager(QUrl(url));
 		}
 
-		// prepare the request
-		QNetworkRequest request;
-		request.setUrl(QUrl(url));
-
 		// send
-		QNetworkReply * reply = networkManager->get(request);
-		QObject::connect(reply, &QNetworkReply::finished, [=] (void) {
-			QNetworkReply::NetworkError error = reply->error();
-			QVariant statusCode = reply->attribute(QNetworkRequest::Attribute::HttpStatusCodeAttribute);
-			if (statusCode.isValid())
-			{
-				// redirect
-				if (statusCode.toInt() == 301)
+		bufferSize = qMax(qint64(1), bufferSize);
+		auto timing = StartTiming(url);
+		RunInThread(networkManager, [=] (void) {
+			auto attempt = std::make_shared< Attempt >();
+			attempt->timing = timing;
+			attempt->options = options;
+			attempt->deadline = QDeadlineTimer(options.timeout < 0 ? -1 : options.timeout);
+			Stream(networkManager, QUrl(url), attempt, bufferSize, qMax(0, options.maxRedirections), chunk, WithTiming(timing, success), WithTiming(timing, failure));
+		});
+	}
+
+	//!
+	//! Asynchronously download a url directly into @p device, which must be opened for
+	//! writing and remain valid until one of the callbacks is called. Only @p bufferSize
+	//! bytes are kept in memory at any time.
+	//!
+	//! @note
+	//!		The device is written from the thread of the network manager.
+	//!
+	void DownloadUrl(const QString & url, QIODevice * device, const CompletionCallback & success, const FailureCallback & failure, qint64 bufferSize, QNetworkAccessManager * networkManager)
+	{
+		RequestOptions options;
+		options.networkManager = networkManager;
+		DownloadUrl(url, device, success, failure, options, bufferSize);
+	}
+
+	//!
+	//! Asynchronously download a url into @p device with the given @p options. See the
+	//! other overload and StreamUrl for more information.
+	//!
+	void DownloadUrl(const QString & url, QIODevice * device, const CompletionCallback & success, const FailureCallback & failure, const RequestOptions & options, qint64 bufferSize)
+	{
+		Q_ASSERT(device != nullptr && device->isWritable() == true);
+		auto writeError = std::make_shared< QString >();
+		StreamUrl(
+			url,
+			[=] (const QByteArray & data) {
+				if (device->write(data) != data.size())
 				{
-					QString redirection = reply->header(QNetworkRequest::KnownHeaders::LocationHeader).toString();
-					reply->deleteLater();
-					RequestUrl(redirection, success, failure);
-					return;
+					*writeError = device->errorString();
+					return false;
 				}
-			}
-			if (error != QNetworkReply::NoError)
-			{
-				QString errorString = reply->errorString();
-				reply->deleteLater();
+				return true;
+			},
+			success,
+			[=] (QNetworkReply::NetworkError error, QString errorString) {
+				failure(error, writeError->isEmpty() ? errorString : *writeError);
+			},
+			options,
+			bufferSize
+		);
+	}
+
+	//!
+	//! Asynchronously download a url into the file @p filename. The file is only replaced
+	//! once the download successfully completed: on failure, any previous content is kept.
+	//!
+	void DownloadUrl(const QString & url, const QString & filename, const CompletionCallback & success, const FailureCallback & failure, qint64 bufferSize, QNetworkAccessManager * networkManager)
+	{
+		RequestOptions options;
+		options.networkManager = networkManager;
+		DownloadUrl(url, filename, success, failure, options, bufferSize);
+	}
+
+	//!
+	//! Asynchronously download a url into the file @p filename with the given @p options.
+	//! See the other overload and StreamUrl for more information.
+	//!
+	//! @note
+	//!		Like every other error, failing to open the file is reported from the thread of
+	//!		the network manager, never from the calling thread.
+	//!
+	void DownloadUrl(const QString & url, const QString & filename, const CompletionCallback & success, const FailureCallback & failure, const RequestOptions & options, qint64 bufferSize)
+	{
+		auto file = std::make_shared< QSaveFile >(filename);
+		if (file->open(QIODevice::WriteOnly) == false)
+		{
+			QNetworkAccessManager * networkManager = options.networkManager != nullptr ? options.networkManager : GetNetworkManager(QUrl(url));
+			const QString errorString = file->errorString();
+			QMetaObject::invokeMethod(networkManager, [failure, errorString] (void) {
+				failure(QNetworkReply::UnknownContentError, errorString);
+			}, Qt::QueuedConnection);
+			return;
+		}
+
+		DownloadUrl(
+			url,
+			file.get(),
+			[=] (qint64 size) {
+				if (file->commit() == false)
+				{
+					failure(QNetworkReply::UnknownContentError, file->errorString());
+				}
+				else
+				{
+					success(size);
+				}
+			},
+			[=] (QNetworkReply::NetworkError error, QString errorString) {
+				file->cancelWriting();
+				file->commit();
 				failure(error, errorString);
-			}
-			else
-			{
-				QByteArray result = reply->readAll();
-				reply->deleteLater();
-				success(result);
-			}
+			},
+			options,
+			bufferSize
+		);
+	}
+
+	//!
+	//! Asynchronously request a JSON document. The reply is parsed on a Job worker, and only
+	//! the parsed document is delivered. See RequestDecoded for the thread the callbacks are
+	//! called from.
+	//!
+	void RequestJson(const QString & url, const JsonCallback & success, const FailureCallback & failure, QObject * context, const RequestOptions & options)
+	{
+		RequestDecoded< QJsonDocument >(
+			url,
+			[] (const QByteArray & data, QJsonDocument & document, QString & errorString) {
+				QJsonParseError error;
+				document = QJsonDocument::fromJson(data, &error);
+				errorString = error.errorString();
+				return error.error == QJsonParseError::NoError;
+			},
+			success,
+			failure,
+			context,
+			options
+		);
+	}
+
+	//!
+	//! Create a body uploading @p data. The data is shared with the network stack, not copied.
+	//!
+	RequestBody RequestBody::FromData(const QByteArray & data, const QByteArray & contentType)
+	{
+		RequestBody body;
+		body.data			= data;
+		body.contentType	= contentType;
+		return body;
+	}
+
+	//!
+	//! Create a body uploading the content of @p device, from its current position. The device
+	//! must be opened for reading and remain valid until the request is finished, and it's
+	//! read from the thread of the network manager.
+	//!
+	//! @param size
+	//!		Number of bytes to upload. It's needed to stream sequential devices: if it's
+	//!		negative, they're entirely read in memory before being sent.
+	//!
+	RequestBody RequestBody::FromDevice(QIODevice * device, qint64 size, const QByteArray & contentType)
+	{
+		Q_ASSERT(device != nullptr && device->isReadable() == true);
+		RequestBody body;
+		body.device			= device;
+		body.size			= size;
+		body.contentType	= contentType;
+		return body;
+	}
+
+	//!
+	//! Create a body uploading the file @p filename. The file is memory mapped and sent from the
+	//! mapping, so uploading it doesn't need memory proportional to its size.
+	//!
+	RequestBody RequestBody::FromFile(const QString & filename, const QByteArray & contentType)
+	{
+		RequestBody body;
+		body.filename		= filename;
+		body.contentType	= contentType;
+		return body;
+	}
+
+	//!
+	//! Synchronously send @p body to a url with a POST request. Like RequestUrl, this can
+	//! be called from any thread: the calling thread sleeps until the request is finished.
+	//!
+	//! @returns
+	//!		The reply or an empty array (on error or timeout)
+	//!
+	QByteArray PostUrl(const QString & url, const RequestBody & body, const RequestOptions & options)
+	{
+		return Wait(url, options, [&] (const SuccessCallback & success, const FailureCallback & failure) {
+			SendUpload("POST", url, body, options, success, failure);
+		});
+	}
+
+	//!
+	//! Asynchronously send @p body to a url with a POST request. The callbacks are called
+	//! from the thread of the network manager.
+	//!
+	//! @note
+	//!		Uploads are never deduplicated, cached, hedged nor retried.
+	//!
+	void PostUrl(const QString & url, const RequestBody & body, const SuccessCallback & success, const FailureCallback & failure, const RequestOptions & options)
+	{
+		SendUpload("POST", url, body, options, success, failure);
+	}
+
+	//!
+	//! Asynchronously send @p body to a url with a POST request, streaming the reply. See
+	//! StreamUrl for the details of the callbacks.
+	//!
+	void StreamPostUrl(const QString & url, const RequestBody & body, const ChunkCallback & chunk, const CompletionCallback & success, const FailureCallback & failure, qint64 bufferSize, const RequestOptions & options)
+	{
+		SendUpload("POST", url, body, options, bufferSize, chunk, success, failure);
+	}
+
+	//!
+	//! Synchronously send @p body to a url with a PUT request. See PostUrl.
+	//!
+	QByteArray PutUrl(const QString & url, const RequestBody & body, const RequestOptions & options)
+	{
+		return Wait(url, options, [&] (const SuccessCallback & success, const FailureCallback & failure) {
+			SendUpload("PUT", url, body, options, success, failure);
 		});
 	}
 
+	//!
+	//! Asynchronously send @p body to a url with a PUT request. See PostUrl.
+	//!
+	void PutUrl(const QString & url, const RequestBody & body, const SuccessCallback & success, const FailureCallback & failure, const RequestOptions & options)
+	{
+		SendUpload("PUT", url, body, options, success, failure);
+	}
+
+	//!
+	//! Asynchronously send @p body to a url with a PUT request, streaming the reply. See
+	//! StreamPostUrl.
+	//!
+	void StreamPutUrl(const QString & url, const RequestBody & body, const ChunkCallback & chunk, const CompletionCallback & success, const FailureCallback & failure, qint64 bufferSize, const RequestOptions & options)
+	{
+		SendUpload("PUT", url, body, options, bufferSize, chunk, success, failure);
+	}
+
 QT_UTILS_NAMESPACE_END
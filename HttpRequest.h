@@ -2,9 +2,16 @@
 #define QT_UTILS_HTTP_REQUEST_H
 
 #include "./Setup.h"
+#include "./Job.h"
 
+#include <QHash>
+#include <QJsonDocument>
 #include <QString>
 #include <QNetworkReply>
+#include <QUrl>
+
+#include <functional>
+#include <memory>
 
 
 QT_UTILS_NAMESPACE_BEGIN
@@ -21,9 +28,248 @@ QT_UTILS_NAMESPACE_BEGIN
 	//!
 	typedef std::function< void (QNetworkReply::NetworkError error, QString errorString) > FailureCallback;
 
+	//!
+	//! Defines the signature of a function like object that will be called each time
+	//! a chunk of data has been received by a streamed request. Returning false aborts
+	//! the request.
+	//!
+	typedef std::function< bool (const QByteArray & chunk) > ChunkCallback;
+
+	//!
+	//! Defines the signature of a function like object that will be called when a
+	//! streamed request has been successfully completed, with the number of bytes
+	//! that were received.
+	//!
+	typedef std::function< void (qint64 size) > CompletionCallback;
+
+	//!
+	//! Defines the signature of a function like object used to decode the body of a reply
+	//! into @p result. It returns false and sets @p errorString if the data is invalid.
+	//!
+	template< typename T >
+	using DecoderCallback = std::function< bool (const QByteArray & data, T & result, QString & errorString) >;
+
+	//!
+	//! Defines the signature of a function like object that will be called with the result
+	//! of a decoded request.
+	//!
+	template< typename T >
+	using DecodedCallback = std::function< void (const T & result) >;
+
+	//!
+	//! Defines the signature of a function like object that will be called with the parsed
+	//! reply of a JSON request.
+	//!
+	typedef DecodedCallback< QJsonDocument > JsonCallback;
+
+	//!
+	//! Defines the signature of a function like object that will be called while the body
+	//! of an upload is being sent, with the number of bytes sent so far and the total.
+	//!
+	typedef std::function< void (qint64 sent, qint64 total) > ProgressCallback;
+
+	//!
+	//! Body of an upload request. Create it with one of the static methods, from memory, from
+	//! a device or from a file. In any case the body is streamed to the network without
+	//! being copied in memory.
+	//!
+	struct RequestBody
+	{
+		//! The data to upload, when uploading from memory
+		QByteArray data;
+
+		//! The device to upload from, if any
+		QIODevice * device = nullptr;
+
+		//! The number of bytes to upload from the device, or -1 if unknown
+		qint64 size = -1;
+
+		//! The file to upload, if any
+		QString filename;
+
+		//! The content type of the body
+		QByteArray contentType;
+
+		//! Optional callback reporting the upload progress
+		ProgressCallback progress;
+
+		static RequestBody	FromData(const QByteArray & data, const QByteArray & contentType = "application/octet-stream");
+		static RequestBody	FromDevice(QIODevice * device, qint64 size = -1, const QByteArray & contentType = "application/octet-stream");
+		static RequestBody	FromFile(const QString & filename, const QByteArray & contentType = "application/octet-stream");
+	};
+
+	//!
+	//! Per request options.
+	//!
+	struct RequestOptions
+	{
+		//! Network manager to use. If nullptr, one of the pooled network managers is used.
+		QNetworkAccessManager * networkManager = nullptr;
+
+		//! Timeout in milliseconds for the whole request, retries included, or a negative value
+		//! for no timeout. A request that times out fails with QNetworkReply::TimeoutError.
+		int timeout = -1;
+
+		//! If true, identical concurrent requests (same url, network manager and options) are coalesced
+		//! into a single network request.
+		bool deduplicate = true;
+
+		//! Maximum number of redirections (301, 302, 303, 307 and 308) to follow.
+		int maxRedirections = 8;
+
+		//! Allow HTTP/2 when the server supports it.
+		bool http2 = true;
+
+		//! If true, a duplicate request is sent when no reply arrived after the hedging delay,
+		//! and the first reply wins.
+		bool hedge = false;
+
+		//! Percentile of the recent latencies of the host used as the hedging delay.
+		double hedgePercentile = 0.95;
+
+		//! Number of times a request failing with a transient error is retried.
+		int retries = 0;
+
+		//! Delay in milliseconds before the first retry. It's doubled on each retry, and jittered.
+		int retryDelay = 100;
+	};
+
+	//!
+	//! Connection statistics of a host.
+	//!
+	struct HostStats
+	{
+		//! Number of finished requests
+		qint64 requests = 0;
+
+		//! Number of TLS handshakes, e.g. new encrypted connections opened by requests
+		qint64 handshakes = 0;
+
+		//! Number of requests that were multiplexed over HTTP/2
+		qint64 http2Requests = 0;
+
+		//! Number of calls to Preconnect
+		qint64 preconnections = 0;
+	};
+
+	//!
+	//! Timings of a finished request. All durations are in microseconds, since the request
+	//! was made.
+	//!
+	struct RequestTiming
+	{
+		//! The requested url
+		QString url;
+
+		//! Time before the request was sent: dispatch to the network thread, or the whole
+		//! request if it was served from the cache
+		qint64 queued = 0;
+
+		//! Time until the headers of the reply were received (time to first byte), or -1
+		qint64 firstByte = -1;
+
+		//! Total time
+		qint64 total = 0;
+
+		//! Size of the body of the reply
+		qint64 bytes = 0;
+
+		//! The error, if the request failed
+		QNetworkReply::NetworkError error = QNetworkReply::NoError;
+	};
+
+	//!
+	//! Defines the signature of a function like object that will be called with the timings
+	//! of each finished request.
+	//!
+	typedef std::function< void (const RequestTiming & timing) > TimingCallback;
+
+	// network managers
+	void						SetNetworkThreadCount(int count);
+	QNetworkAccessManager *		GetNetworkManager(const QUrl & url);
+	void						Preconnect(const QString & url, QNetworkAccessManager * networkManager = nullptr);
+	QHash< QString, HostStats >	GetHostStats(void);
+	void						ResetHostStats(void);
+
 	// helpers
-	QByteArray	RequestUrl(const QString & url, QNetworkAccessManager * networkManager = nullptr);
+	QByteArray	RequestUrl(const QString & url, QNetworkAccessManager * networkManager = nullptr, int timeout = -1);
+	QByteArray	RequestUrl(const QString & url, const RequestOptions & options);
 	void		RequestUrl(const QString & url, const SuccessCallback & success, const FailureCallback & failure, QNetworkAccessManager * networkManager = nullptr);
+	void		RequestUrl(const QString & url, const SuccessCallback & success, const FailureCallback & failure, const RequestOptions & options);
+	qint64		GetDeduplicatedRequestCount(void);
+	void		SetTimingCallback(const TimingCallback & callback);
+	void		ClearRedirectionCache(void);
+
+	// streaming helpers
+	void		StreamUrl(const QString & url, const ChunkCallback & chunk, const CompletionCallback & success, const FailureCallback & failure, qint64 bufferSize = 64 * 1024, QNetworkAccessManager * networkManager = nullptr);
+	void		StreamUrl(const QString & url, const ChunkCallback & chunk, const CompletionCallback & success, const FailureCallback & failure, const RequestOptions & options, qint64 bufferSize = 64 * 1024);
+	void		DownloadUrl(const QString & url, QIODevice * device, const CompletionCallback & success, const FailureCallback & failure, qint64 bufferSize = 64 * 1024, QNetworkAccessManager * networkManager = nullptr);
+	void		DownloadUrl(const QString & url, QIODevice * device, const CompletionCallback & success, const FailureCallback & failure, const RequestOptions & options, qint64 bufferSize = 64 * 1024);
+	void		DownloadUrl(const QString & url, const QString & filename, const CompletionCallback & success, const FailureCallback & failure, qint64 bufferSize = 64 * 1024, QNetworkAccessManager * networkManager = nullptr);
+	void		DownloadUrl(const QString & url, const QString & filename, const CompletionCallback & success, const FailureCallback & failure, const RequestOptions & options, qint64 bufferSize = 64 * 1024);
+
+	// decoding helpers
+	void		RequestJson(const QString & url, const JsonCallback & success, const FailureCallback & failure, QObject * context = nullptr, const RequestOptions & options = RequestOptions());
+	template< typename T >
+	void		RequestDecoded(const QString & url, const DecoderCallback< T > & decoder, const DecodedCallback< T > & success, const FailureCallback & failure, QObject * context = nullptr, const RequestOptions & options = RequestOptions());
+
+	// upload helpers
+	QByteArray	PostUrl(const QString & url, const RequestBody & body, const RequestOptions & options = RequestOptions());
+	void		PostUrl(const QString & url, const RequestBody & body, const SuccessCallback & success, const FailureCallback & failure, const RequestOptions & options = RequestOptions());
+	void		StreamPostUrl(const QString & url, const RequestBody & body, const ChunkCallback & chunk, const CompletionCallback & success, const FailureCallback & failure, qint64 bufferSize = 64 * 1024, const RequestOptions & options = RequestOptions());
+	QByteArray	PutUrl(const QString & url, const RequestBody & body, const RequestOptions & options = RequestOptions());
+	void		PutUrl(const QString & url, const RequestBody & body, const SuccessCallback & success, const FailureCallback & failure, const RequestOptions & options = RequestOptions());
+	void		StreamPutUrl(const QString & url, const RequestBody & body, const ChunkCallback & chunk, const CompletionCallback & success, const FailureCallback & failure, qint64 bufferSize = 64 * 1024, const RequestOptions & options = RequestOptions());
+
+	//!
+	//! Asynchronously request a url and decode the reply on a Job worker, so that decoding
+	//! big replies never blocks the network threads nor the GUI one. The type of the result
+	//! must be given explicitly:
+	//!
+	//! ```.cpp
+	//! RequestDecoded< QImage >(url, decoder, success, failure, this);
+	//! ```
+	//!
+	//! @param decoder
+	//!		Function decoding the reply. It's called from a Job worker. If it fails, @p failure
+	//!		is called with QNetworkReply::UnknownContentError.
+	//!
+	//! @param context
+	//!		If not nullptr, @p success and @p failure are called from the thread of this object,
+	//!		and not called at all if it's destroyed before. Otherwise @p success is called from
+	//!		the Job worker and @p failure from the network thread.
+	//!
+	template< typename T >
+	void RequestDecoded(const QString & url, const DecoderCallback< T > & decoder, const DecodedCallback< T > & success, const FailureCallback & failure, QObject * context, const RequestOptions & options)
+	{
+		// connected to the context now, so that the results are safely dropped if it's destroyed
+		auto delivery = Delivery::Create(context);
+		auto deliver = [delivery] (const std::function< void (void) > & callback) {
+			delivery->Post(callback);
+		};
+
+		RequestUrl(
+			url,
+			[=] (QByteArray reply) {
+				new Job([=] (void) {
+					auto result = std::make_shared< T >();
+					QString errorString;
+					if (decoder(reply, *result, errorString) == true)
+					{
+						deliver([=] (void) { success(*result); });
+					}
+					else
+					{
+						deliver([=] (void) { failure(QNetworkReply::UnknownContentError, errorString); });
+					}
+				}, "RequestDecoded");
+			},
+			[=] (QNetworkReply::NetworkError error, QString errorString) {
+				deliver([=] (void) { failure(error, errorString); });
+			},
+			options
+		);
+	}
 
 QT_UTILS_NAMESPACE_END
 
@@ -1,5 +1,9 @@
 #include "./Job.h"
+#include "./JobTelemetry.h"
 
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQueue>
 #include <QThreadPool>
 
 
@@ -12,8 +16,29 @@ QT_UTILS_NAMESPACE_BEGIN
 	//!		The job to execute.
 	//!
 	Job::Job(const std::function< void (void) > & job)
+		: Job(job, QString())
+	{
+	}
+
+	//!
+	//! Constructor.
+	//!
+	//! @param job
+	//!		The job to execute.
+	//!
+	//! @param label
+	//!		Label used to identify the job in JobTelemetry.
+	//!
+	Job::Job(const std::function< void (void) > & job, const QString & label)
 		: m_Job(job)
+		, m_Label(label)
+		, m_Queued(-1)
 	{
+		if (JobTelemetry::IsEnabled() == true)
+		{
+			m_Queued = JobTelemetry::Now();
+			JobTelemetry::JobQueued();
+		}
 		QThreadPool::globalInstance()->start(this);
 	}
 
@@ -22,7 +47,88 @@ QT_UTILS_NAMESPACE_BEGIN
 	//!
 	void Job::run(void)
 	{
+		if (m_Queued == -1)
+		{
+			m_Job();
+			return;
+		}
+
+		const qint64 started = JobTelemetry::Now();
+		JobTelemetry::JobStarted();
 		m_Job();
+		JobTelemetry::JobFinished(m_Label, m_Queued, started, JobTelemetry::Now());
+	}
+
+	//!
+	//! The callbacks posted to a Delivery, in order. Each emission of the posted signal
+	//! runs the oldest one.
+	//!
+	struct Delivery::Queue
+	{
+		QMutex mutex;
+		QQueue< std::function< void (void) > > callbacks;
+	};
+
+	//!
+	//! Constructor.
+	//!
+	//! @param context
+	//!		The object from the thread of which the callbacks are called. It must be alive.
+	//!
+	Delivery::Delivery(QObject * context)
+	{
+		if (context == nullptr)
+		{
+			return;
+		}
+
+		// the connection owns its own reference to the queue, so that calls already queued
+		// when this instance is destroyed are still valid
+		m_Queue = std::make_shared< Queue >();
+		QObject::connect(this, &Delivery::posted, context, [queue = m_Queue] (void) {
+			std::function< void (void) > callback;
+			{
+				QMutexLocker lock(&queue->mutex);
+				if (queue->callbacks.isEmpty() == true)
+				{
+					return;
+				}
+				callback = queue->callbacks.dequeue();
+			}
+			callback();
+		}, Qt::QueuedConnection);
+	}
+
+	//!
+	//! Create a shared delivery. It's deleted with deleteLater, so that releasing the last
+	//! reference from another thread never destroys it outside of its own thread.
+	//!
+	//! @param context
+	//!		The object from the thread of which the callbacks are called. It must be alive.
+	//!
+	std::shared_ptr< Delivery > Delivery::Create(QObject * context)
+	{
+		return std::shared_ptr< Delivery >(new Delivery(context), [] (Delivery * delivery) {
+			delivery->deleteLater();
+		});
+	}
+
+	//!
+	//! Post @p callback to the thread of the context. This can be called from any thread.
+	//!
+	void Delivery::Post(const std::function< void (void) > & callback)
+	{
+		if (m_Queue == nullptr)
+		{
+			callback();
+			return;
+		}
+
+		{
+			QMutexLocker lock(&m_Queue->mutex);
+			m_Queue->callbacks.enqueue(callback);
+		}
+		emit posted();
 	}
 
 QT_UTILS_NAMESPACE_END
@@ -3,9 +3,12 @@
 
 #include "./Setup.h"
 
+#include <QObject>
 #include <QRunnable>
+#include <QString>
 
 #include <functional>
+#include <memory>
 
 
 QT_UTILS_NAMESPACE_BEGIN
@@ -22,6 +25,9 @@ QT_UTILS_NAMESPACE_BEGIN
 	//! });
 	//! ```
 	//!
+	//! An optional label can be given as a second argument. It's only used
+	//! by JobTelemetry to aggregate and name the jobs.
+	//!
 	class Job
 		: public QRunnable
 	{
@@ -29,6 +35,7 @@ QT_UTILS_NAMESPACE_BEGIN
 	public:
 
 		Job(const std::function< void (void) > & job);
+		Job(const std::function< void (void) > & job, const QString & label);
 
 	protected:
 
@@ -39,6 +46,63 @@ QT_UTILS_NAMESPACE_BEGIN
 		//! The job function
 		std::function< void (void) > m_Job;
 
+		//! Optional label
+		QString m_Label;
+
+		//! Time at which the job was queued, or -1 if telemetry is disabled
+		qint64 m_Queued;
+
+	};
+
+	//!
+	//! Posts callbacks from any thread (typically from a Job) to the thread of a context
+	//! object. The callbacks are dropped if the context is destroyed before they run.
+	//!
+	//! Unlike a QPointer to the context, it never touches the context outside of its thread:
+	//! it's connected to the context when created, and Qt drops the queued calls when the
+	//! context is destroyed. So it must be created while the context is alive, usually from
+	//! the thread of the context, and can then be used from any thread. Since the last reference
+	//! is usually released from another thread, it's created with Create, which deletes it
+	//! from its own thread:
+	//!
+	//! ```.cpp
+	//! auto delivery = Delivery::Create(this);
+	//! new Job([this, delivery] (void) {
+	//! 	const QString result = DoSomething();
+	//! 	delivery->Post([this, result] (void) {
+	//! 		// called from the thread of this, and only if it's still alive
+	//! 	});
+	//! });
+	//! ```
+	//!
+	//! If the context is nullptr, the callbacks are directly called from the posting thread.
+	//!
+	class Delivery
+		: public QObject
+	{
+
+		Q_OBJECT
+
+	signals:
+
+		void posted(void);
+
+	public:
+
+		Delivery(QObject * context);
+
+		static std::shared_ptr< Delivery > Create(QObject * context);
+
+		void Post(const std::function< void (void) > & callback);
+
+	private:
+
+		//! The posted callbacks, shared with the connection
+		struct Queue;
+
+		//! The posted callbacks, or nullptr if there's no context
+		std::shared_ptr< Queue > m_Queue;
+
 	};
 
 QT_UTILS_NAMESPACE_END
@@ -0,0 +1,370 @@
+#include "./JobTelemetry.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+#include <limits>
+
+
+QT_UTILS_NAMESPACE_BEGIN
+
+	//!
+	//! A single job trace.
+	//!
+	struct TraceEvent
+	{
+		QString label;
+		qint64 queued;
+		qint64 started;
+		qint64 finished;
+		int thread;
+	};
+
+	//!
+	//! The aggregated data, protected by a mutex.
+	//!
+	struct TelemetryData
+	{
+		QMutex mutex;
+		JobTelemetry::Histogram wait;
+		JobTelemetry::Histogram run;
+		QHash< QString, JobTelemetry::Histogram > labelWait;
+		QHash< QString, JobTelemetry::Histogram > labelRun;
+		QVector< TraceEvent > trace;
+		int traceCapacity = 65536;
+		int traceNext = 0;
+	};
+
+	//! Enabled state
+	static std::atomic< bool > s_Enabled{ false };
+
+	//! Number of jobs waiting for a thread
+	static std::atomic< int > s_Queued{ 0 };
+
+	//! Number of jobs currently running
+	static std::atomic< int > s_Running{ 0 };
+
+	//! Used to give small, stable indices to the threads
+	static std::atomic< int > s_ThreadCount{ 0 };
+
+	//! Index of the current thread in the traces
+	static thread_local int s_ThreadIndex = -1;
+
+	//!
+	//! Get the telemetry data.
+	//!
+	static TelemetryData & GetData(void)
+	{
+		static TelemetryData data;
+		return data;
+	}
+
+	//!
+	//! Convert nanoseconds to microseconds.
+	//!
+	static inline qint64 ToMicroseconds(qint64 nanoseconds)
+	{
+		return nanoseconds / 1000;
+	}
+
+	//!
+	//! Constructor
+	//!
+	JobTelemetry::Histogram::Histogram(void)
+		: m_Buckets{}
+		, m_Count(0)
+		, m_Total(0)
+		, m_Min(std::numeric_limits< qint64 >::max())
+		, m_Max(0)
+	{
+	}
+
+	//!
+	//! Add a sample to the histogram.
+	//!
+	void JobTelemetry::Histogram::Add(qint64 microseconds)
+	{
+		microseconds = qMax(microseconds, qint64(0));
+		int bucket = 0;
+		for (qint64 value = microseconds >> 1; value != 0 && bucket < BucketCount - 1; value >>= 1)
+		{
+			++bucket;
+		}
+		++m_Buckets[bucket];
+		++m_Count;
+		m_Total += microseconds;
+		m_Min = qMin(m_Min, microseconds);
+		m_Max = qMax(m_Max, microseconds);
+	}
+
+	//!
+	//! Merge another histogram into this one.
+	//!
+	void JobTelemetry::Histogram::Merge(const Histogram & other)
+	{
+		for (int i = 0; i < BucketCount; ++i)
+		{
+			m_Buckets[i] += other.m_Buckets[i];
+		}
+		m_Count += other.m_Count;
+		m_Total += other.m_Total;
+		m_Min = qMin(m_Min, other.m_Min);
+		m_Max = qMax(m_Max, other.m_Max);
+	}
+
+	//!
+	//! Get an approximation of the given @p percentile (in the [0, 1] range) This
+	//! returns the upper bound of the bucket containing the percentile, clamped to
+	//! the maximum sample.
+	//!
+	qint64 JobTelemetry::Histogram::Percentile(double percentile) const
+	{
+		if (m_Count == 0)
+		{
+			return 0;
+		}
+
+		const qint64 target = qMax(qint64(1), qint64(qBound(0.0, percentile, 1.0) * m_Count + 0.5));
+		qint64 accumulated = 0;
+		for (int i = 0; i < BucketCount; ++i)
+		{
+			accumulated += m_Buckets[i];
+			if (accumulated >= target)
+			{
+				return qMin((qint64(1) << (i + 1)) - 1, m_Max);
+			}
+		}
+		return m_Max;
+	}
+
+	//!
+	//! Enable or disable the telemetry. Jobs created while disabled are never
+	//! recorded, even if they run after the telemetry was enabled.
+	//!
+	void JobTelemetry::SetEnabled(bool enabled)
+	{
+		s_Enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	//!
+	//! Returns true if the telemetry is enabled.
+	//!
+	bool JobTelemetry::IsEnabled(void)
+	{
+		return s_Enabled.load(std::memory_order_relaxed);
+	}
+
+	//!
+	//! Set the maximum number of job traces kept in memory. When full, the oldest
+	//! traces are overwritten. Defaults to 65536. Setting it clears the current traces.
+	//!
+	void JobTelemetry::SetTraceCapacity(int capacity)
+	{
+		TelemetryData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		data.traceCapacity = qMax(0, capacity);
+		data.trace.clear();
+		data.traceNext = 0;
+	}
+
+	//!
+	//! Clear all histograms and traces.
+	//!
+	void JobTelemetry::Reset(void)
+	{
+		TelemetryData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		data.wait = Histogram();
+		data.run = Histogram();
+		data.labelWait.clear();
+		data.labelRun.clear();
+		data.trace.clear();
+		data.traceNext = 0;
+	}
+
+	//!
+	//! Get the histogram of the times spent by jobs between their creation and the
+	//! moment they started running. If @p label is not empty, only the jobs with
+	//! that label are considered.
+	//!
+	JobTelemetry::Histogram JobTelemetry::GetWaitTimes(const QString & label)
+	{
+		TelemetryData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		return label.isEmpty() ? data.wait : data.labelWait.value(label);
+	}
+
+	//!
+	//! Get the histogram of the times spent running jobs. If @p label is not empty,
+	//! only the jobs with that label are considered.
+	//!
+	JobTelemetry::Histogram JobTelemetry::GetRunTimes(const QString & label)
+	{
+		TelemetryData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		return label.isEmpty() ? data.run : data.labelRun.value(label);
+	}
+
+	//!
+	//! Get the list of labels that were recorded.
+	//!
+	QStringList JobTelemetry::GetLabels(void)
+	{
+		TelemetryData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		return data.labelRun.keys();
+	}
+
+	//!
+	//! Get a snapshot of the state of the pool. The thread counts come from the pool, so they
+	//! include the runnables that aren't jobs, while the active jobs and queue depth counts
+	//! only account for the jobs created while the telemetry was enabled.
+	//!
+	JobTelemetry::PoolStats JobTelemetry::GetPoolStats(void)
+	{
+		const QThreadPool * pool = QThreadPool::globalInstance();
+		PoolStats stats;
+		stats.maxThreads	= pool->maxThreadCount();
+		stats.activeThreads	= pool->activeThreadCount();
+		stats.idleThreads	= qMax(0, stats.maxThreads - stats.activeThreads);
+		stats.activeJobs	= s_Running.load(std::memory_order_relaxed);
+		stats.queueDepth	= s_Queued.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	//!
+	//! Get the recorded traces in the Chrome trace-event JSON format. Each job is
+	//! a complete event on the thread that ran it, with its wait time as argument.
+	//!
+	QByteArray JobTelemetry::ToChromeTrace(void)
+	{
+		TelemetryData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+
+		QJsonArray events;
+		QVector< bool > namedThreads;
+		for (const TraceEvent & trace : data.trace)
+		{
+			// name the threads once
+			if (trace.thread >= namedThreads.size())
+			{
+				namedThreads.resize(trace.thread + 1);
+			}
+			if (namedThreads[trace.thread] == false)
+			{
+				namedThreads[trace.thread] = true;
+				events.append(QJsonObject{
+					{ "name",	"thread_name" },
+					{ "ph",		"M" },
+					{ "pid",	1 },
+					{ "tid",	trace.thread },
+					{ "args",	QJsonObject{ { "name", QString("Job worker %1").arg(trace.thread) } } }
+				});
+			}
+
+			events.append(QJsonObject{
+				{ "name",	trace.label.isEmpty() ? QString("Job") : trace.label },
+				{ "cat",	"job" },
+				{ "ph",		"X" },
+				{ "pid",	1 },
+				{ "tid",	trace.thread },
+				{ "ts",		trace.started / 1000.0 },
+				{ "dur",	(trace.finished - trace.started) / 1000.0 },
+				{ "args",	QJsonObject{ { "wait_us", (trace.started - trace.queued) / 1000.0 } } }
+			});
+		}
+
+		return QJsonDocument(QJsonObject{ { "traceEvents", events } }).toJson(QJsonDocument::Compact);
+	}
+
+	//!
+	//! Write the Chrome trace to @p filename. Returns true on success.
+	//!
+	bool JobTelemetry::ExportTrace(const QString & filename)
+	{
+		const QByteArray trace = ToChromeTrace();
+		QFile file(filename);
+		return file.open(QIODevice::WriteOnly) == true && file.write(trace) == trace.size();
+	}
+
+	//!
+	//! Get the current timestamp, in nanoseconds.
+	//!
+	qint64 JobTelemetry::Now(void)
+	{
+		static const QElapsedTimer timer = [] (void) {
+			QElapsedTimer t;
+			t.start();
+			return t;
+		}();
+		return timer.nsecsElapsed();
+	}
+
+	//!
+	//! Called when a job was pushed to the pool.
+	//!
+	void JobTelemetry::JobQueued(void)
+	{
+		s_Queued.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//!
+	//! Called when a job starts running.
+	//!
+	void JobTelemetry::JobStarted(void)
+	{
+		s_Queued.fetch_sub(1, std::memory_order_relaxed);
+		s_Running.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//!
+	//! Called when a job finished running.
+	//!
+	void JobTelemetry::JobFinished(const QString & label, qint64 queued, qint64 started, qint64 finished)
+	{
+		s_Running.fetch_sub(1, std::memory_order_relaxed);
+
+		if (s_ThreadIndex == -1)
+		{
+			s_ThreadIndex = s_ThreadCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		const qint64 wait	= ToMicroseconds(started - queued);
+		const qint64 run	= ToMicroseconds(finished - started);
+
+		TelemetryData & data = GetData();
+		QMutexLocker lock(&data.mutex);
+		data.wait.Add(wait);
+		data.run.Add(run);
+		if (label.isEmpty() == false)
+		{
+			data.labelWait[label].Add(wait);
+			data.labelRun[label].Add(run);
+		}
+
+		// ring buffer of traces
+		if (data.traceCapacity > 0)
+		{
+			TraceEvent event{ label, queued, started, finished, s_ThreadIndex };
+			if (data.trace.size() < data.traceCapacity)
+			{
+				data.trace.push_back(event);
+			}
+			else
+			{
+				data.trace[data.traceNext] = event;
+			}
+			data.traceNext = (data.traceNext + 1) % data.traceCapacity;
+		}
+	}
+
+QT_UTILS_NAMESPACE_END
@@ -0,0 +1,178 @@
+#ifndef QT_UTILS_JOB_TELEMETRY_H
+#define QT_UTILS_JOB_TELEMETRY_H
+
+#include "./Setup.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <array>
+
+
+QT_UTILS_NAMESPACE_BEGIN
+
+	//!
+	//! Opt-in instrumentation of the Job executor. When enabled, each Job records
+	//! the time it spent waiting in the thread pool queue and the time it spent
+	//! running. Those are aggregated in histograms (globally and per job label)
+	//! and kept in a bounded trace buffer that can be exported in the Chrome
+	//! trace-event format (open it in chrome://tracing or https://ui.perfetto.dev)
+	//!
+	//! ```.cpp
+	//! JobTelemetry::SetEnabled(true);
+	//!
+	//! new Job([] (void) { ... }, "decode");
+	//!
+	//! // later
+	//! qDebug() << JobTelemetry::GetWaitTimes().Percentile(0.99);
+	//! JobTelemetry::ExportTrace("jobs.json");
+	//! ```
+	//!
+	//! @note
+	//!		When disabled (the default) the only cost for a Job is a relaxed
+	//!		atomic load when it's created.
+	//!
+	class JobTelemetry
+	{
+
+	public:
+
+		//!
+		//! Logarithmic histogram of durations, in microseconds. Bucket 0 holds
+		//! durations below 2us, and bucket i holds durations in [2^i, 2^(i+1))
+		//!
+		class Histogram
+		{
+
+		public:
+
+			//! The number of buckets
+			static constexpr int BucketCount = 32;
+
+			// constructor
+			Histogram(void);
+
+			// API
+			void									Add(qint64 microseconds);
+			void									Merge(const Histogram & other);
+			inline qint64							GetCount(void) const;
+			inline qint64							GetTotal(void) const;
+			inline qint64							GetMin(void) const;
+			inline qint64							GetMax(void) const;
+			inline qint64							GetMean(void) const;
+			qint64									Percentile(double percentile) const;
+			inline const std::array< qint64, BucketCount > &	GetBuckets(void) const;
+
+		private:
+
+			//! The buckets
+			std::array< qint64, BucketCount > m_Buckets;
+
+			//! Number of samples
+			qint64 m_Count;
+
+			//! Sum of all the samples
+			qint64 m_Total;
+
+			//! Smallest sample
+			qint64 m_Min;
+
+			//! Biggest sample
+			qint64 m_Max;
+
+		};
+
+		//!
+		//! Snapshot of the state of the pool used by the jobs.
+		//!
+		struct PoolStats
+		{
+			//! Maximum number of threads of the pool
+			int maxThreads;
+
+			//! Number of threads currently running a runnable (Job or not) or reserved
+			int activeThreads;
+
+			//! Number of threads not running anything
+			int idleThreads;
+
+			//! Number of running jobs created while the telemetry was enabled
+			int activeJobs;
+
+			//! Number of jobs created while the telemetry was enabled and waiting for a thread
+			int queueDepth;
+		};
+
+		// C++ API
+		static void			SetEnabled(bool enabled);
+		static bool			IsEnabled(void);
+		static void			SetTraceCapacity(int capacity);
+		static void			Reset(void);
+		static Histogram	GetWaitTimes(const QString & label = QString());
+		static Histogram	GetRunTimes(const QString & label = QString());
+		static QStringList	GetLabels(void);
+		static PoolStats	GetPoolStats(void);
+		static QByteArray	ToChromeTrace(void);
+		static bool			ExportTrace(const QString & filename);
+
+		// used by Job
+		static qint64		Now(void);
+		static void			JobQueued(void);
+		static void			JobStarted(void);
+		static void			JobFinished(const QString & label, qint64 queued, qint64 started, qint64 finished);
+
+	};
+
+	//!
+	//! Get the number of samples
+	//!
+	inline qint64 JobTelemetry::Histogram::GetCount(void) const
+	{
+		return m_Count;
+	}
+
+	//!
+	//! Get the sum of all the samples
+	//!
+	inline qint64 JobTelemetry::Histogram::GetTotal(void) const
+	{
+		return m_Total;
+	}
+
+	//!
+	//! Get the smallest sample, or 0 if the histogram is empty
+	//!
+	inline qint64 JobTelemetry::Histogram::GetMin(void) const
+	{
+		return m_Count > 0 ? m_Min : 0;
+	}
+
+	//!
+	//! Get the biggest sample
+	//!
+	inline qint64 JobTelemetry::Histogram::GetMax(void) const
+	{
+		return m_Max;
+	}
+
+	//!
+	//! Get the average of the samples
+	//!
+	inline qint64 JobTelemetry::Histogram::GetMean(void) const
+	{
+		return m_Count > 0 ? m_Total / m_Count : 0;
+	}
+
+	//!
+	//! Get the raw buckets
+	//!
+	inline const std::array< qint64, JobTelemetry::Histogram::BucketCount > & JobTelemetry::Histogram::GetBuckets(void) const
+	{
+		return m_Buckets;
+	}
+
+QT_UTILS_NAMESPACE_END
+
+
+#endif
@@ -2,19 +2,269 @@
 #include "./Settings.h"
 #include "./Utils.h"
 
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QQmlComponent>
 #include <QQmlContext>
 #include <QQmlEngine>
+#include <QQmlIncubator>
+#include <QQuickItem>
 #include <QQuickWindow>
 #include <QRect>
 #include <QScreen>
 #include <QThread>
 
+#include <algorithm>
+#include <functional>
+#include <vector>
+
 
 QT_UTILS_NAMESPACE_BEGIN
 
 	//! Settings version
 	static constexpr int s_version = 2;
 
+	//!
+	//! Timestamps of a frame, in microseconds since the recorder was created.
+	//!
+	struct FrameTimestamps
+	{
+		qint64 syncStart = 0;
+		qint64 syncEnd = 0;
+		qint64 renderStart = 0;
+		qint64 renderEnd = 0;
+		qint64 swapped = 0;
+
+		//!
+		//! Time taken by the frame, from the start of its synchronization to its swap. Since
+		//! frames are only rendered on demand, this is used instead of the time between 2
+		//! frames, which also includes the idle periods.
+		//!
+		inline qint64 GetCost(void) const
+		{
+			return syncStart > 0 && swapped >= syncStart ? swapped - syncStart : 0;
+		}
+	};
+
+	//!
+	//! Number of frames kept for the traces (about a minute at 60 fps)
+	//!
+	static constexpr int s_FrameHistory = 4096;
+
+	//!
+	//! Interval between 2 updates of the frame statistics, and window over which they're
+	//! computed, in milliseconds.
+	//!
+	static constexpr int s_FrameStatsInterval = 1000;
+
+	//!
+	//! Records the timestamps of the frames. The current frame is only accessed by the thread
+	//! emitting the scene graph signals (the render thread, or the GUI one depending on the
+	//! render loop) and the finished frames are pushed in a ring buffer.
+	//!
+	struct QuickView::FrameRecorder
+	{
+		//! Clock of the timestamps
+		QElapsedTimer clock;
+
+		//! The frame being rendered
+		FrameTimestamps current;
+
+		//! Protects the finished frames
+		mutable QMutex mutex;
+
+		//! Ring buffer of the finished frames
+		QVector< FrameTimestamps > frames = QVector< FrameTimestamps >(s_FrameHistory);
+
+		//! Index of the next frame in the ring buffer
+		int next = 0;
+
+		//! Number of frames in the ring buffer
+		int count = 0;
+
+		//! Total number of frames
+		qint64 total = 0;
+
+		//! Total number of janks
+		qint64 janks = 0;
+
+		//! Cost of a frame above which it's a jank, in microseconds
+		qint64 jankThreshold = 25000;
+
+		//!
+		//! Get the current timestamp.
+		//!
+		inline qint64 Now(void) const
+		{
+			return clock.nsecsElapsed() / 1000;
+		}
+
+		//!
+		//! Push the current frame once it's been swapped.
+		//!
+		void Push(void)
+		{
+			QMutexLocker lock(&mutex);
+			if (current.GetCost() > jankThreshold)
+			{
+				++janks;
+			}
+			frames[next] = current;
+			next = (next + 1) % s_FrameHistory;
+			count = qMin(count + 1, s_FrameHistory);
+			++total;
+			current = FrameTimestamps();
+		}
+
+		//!
+		//! Get the recorded frames, from the oldest to the most recent one.
+		//!
+		QVector< FrameTimestamps > GetFrames(void) const
+		{
+			QMutexLocker lock(&mutex);
+			QVector< FrameTimestamps > result;
+			result.reserve(count);
+			for (int i = 0; i < count; ++i)
+			{
+				result.push_back(frames[(next - count + i + s_FrameHistory) % s_FrameHistory]);
+			}
+			return result;
+		}
+	};
+
+	//!
+	//! Incubator forwarding its status changes to a callback.
+	//!
+	class QuickViewIncubator
+		: public QQmlIncubator
+	{
+
+	public:
+
+		QuickViewIncubator(const std::function< void (Status) > & callback)
+			: QQmlIncubator(QQmlIncubator::Asynchronous)
+			, m_Callback(callback)
+		{
+		}
+
+	protected:
+
+		void statusChanged(Status status) override
+		{
+			m_Callback(status);
+		}
+
+	private:
+
+		//! The callback
+		std::function< void (Status) > m_Callback;
+
+	};
+
+	//!
+	//! Incubation controller giving the incubating objects a fixed time budget on each frame
+	//! interval, leaving the rest of the frame to the animations and the rendering.
+	//!
+	class QuickViewIncubationController
+		: public QObject
+		, public QQmlIncubationController
+	{
+
+	public:
+
+		QuickViewIncubationController(QObject * parent)
+			: QObject(parent)
+			, m_Budget(8)
+		{
+			QObject::connect(&m_Timer, &QTimer::timeout, this, [this] (void) { incubateFor(m_Budget); });
+		}
+
+		//!
+		//! Set the time budget and the frame interval, in milliseconds.
+		//!
+		void SetBudget(int budget, int frameInterval)
+		{
+			m_Budget = qMax(1, budget);
+			m_Timer.setInterval(qMax(1, frameInterval - m_Budget));
+		}
+
+	protected:
+
+		void incubatingObjectCountChanged(int count) override
+		{
+			if (count == 0)
+			{
+				m_Timer.stop();
+			}
+			else if (m_Timer.isActive() == false)
+			{
+				m_Timer.start();
+			}
+		}
+
+	private:
+
+		//! Drives the incubation
+		QTimer m_Timer;
+
+		//! Incubation time of each frame, in milliseconds
+		int m_Budget;
+
+	};
+
+	//!
+	//! State of an asynchronous loading.
+	//!
+	struct QuickView::AsyncLoading
+	{
+		//! The loaded url
+		QUrl source;
+
+		//! Measures the loading steps
+		QElapsedTimer clock;
+
+		//! The placeholder, if any
+		QPointer< QQmlComponent > placeholderComponent;
+		QPointer< QQuickItem > placeholder;
+
+		//! The component being compiled, then created
+		QPointer< QQmlComponent > component;
+
+		//! Creates the root object. Declared after the component so that it's destroyed first
+		std::unique_ptr< QuickViewIncubator > incubator;
+
+		//! True once the component was given to the view (which then owns it)
+		bool installed = false;
+
+		//! The content being replaced. It's hidden while the placeholder is displayed, and
+		//! destroyed once the new root is installed
+		QUrl previousSource;
+		QPointer< QQuickItem > previousRoot;
+		QPointer< QQmlComponent > previousComponent;
+
+		//! Connection used to detect the first frame
+		QMetaObject::Connection firstFrame;
+
+		~AsyncLoading(void)
+		{
+			QObject::disconnect(firstFrame);
+			incubator.reset();
+			if (installed == false)
+			{
+				delete component.data();
+			}
+			delete placeholder.data();
+			delete placeholderComponent.data();
+		}
+	};
+
 	//!
 	//! Constructor
 	//!
@@ -23,12 +273,479 @@ QT_UTILS_NAMESPACE_BEGIN
 		, m_Maximized(false)
 		, m_FullScreen(false)
 		, m_Flags{}
+		, m_LoadingProgress(1.0)
+		, m_IncubationController(nullptr)
 	{
 		// make the view control the root object size
 		this->setResizeMode(QQuickView::ResizeMode::SizeRootObjectToView);
 
 		// install event filtering
 		this->installEventFilter(this);
+
+		// expose the view to QML
+		this->rootContext()->setContextProperty("rootView", this);
+
+		// frame statistics
+		m_FrameStatsTimer.setInterval(s_FrameStatsInterval);
+		QObject::connect(&m_FrameStatsTimer, &QTimer::timeout, this, &QuickView::UpdateFrameStats);
+	}
+
+	//!
+	//! Destructor
+	//!
+	QuickView::~QuickView(void)
+	{
+		m_AsyncLoading.reset();
+		for (const QMetaObject::Connection & connection : m_FrameConnections)
+		{
+			QObject::disconnect(connection);
+		}
+	}
+
+	//!
+	//! Returns true if the frame timings are recorded.
+	//!
+	bool QuickView::IsFrameTimingEnabled(void) const
+	{
+		return m_FrameRecorder != nullptr;
+	}
+
+	//!
+	//! Enable or disable the recording of the frame timings. When disabled (the default) the
+	//! view isn't even connected to the scene graph signals, so there's no overhead.
+	//!
+	void QuickView::SetFrameTimingEnabled(bool value)
+	{
+		if (value == IsFrameTimingEnabled())
+		{
+			return;
+		}
+
+		if (value == true)
+		{
+			// a frame which took more than 1.5 vertical refresh intervals to produce missed one
+			auto recorder = std::make_shared< FrameRecorder >();
+			const qreal refreshRate = this->screen() != nullptr && this->screen()->refreshRate() > 0.0 ? this->screen()->refreshRate() : 60.0;
+			recorder->jankThreshold = static_cast< qint64 >(1.5e6 / refreshRate);
+			recorder->clock.start();
+			m_FrameRecorder = recorder;
+
+			// the signals are emitted from the render thread, so they're directly connected
+			m_FrameConnections = {
+				QObject::connect(this, &QQuickWindow::beforeSynchronizing, [recorder] (void) { recorder->current.syncStart = recorder->Now(); }),
+				QObject::connect(this, &QQuickWindow::afterSynchronizing, [recorder] (void) { recorder->current.syncEnd = recorder->Now(); }),
+				QObject::connect(this, &QQuickWindow::beforeRendering, [recorder] (void) { recorder->current.renderStart = recorder->Now(); }),
+				QObject::connect(this, &QQuickWindow::afterRendering, [recorder] (void) { recorder->current.renderEnd = recorder->Now(); }),
+				QObject::connect(this, &QQuickWindow::frameSwapped, [recorder] (void) {
+					recorder->current.swapped = recorder->Now();
+					recorder->Push();
+				}),
+			};
+			m_FrameStatsTimer.start();
+		}
+		else
+		{
+			for (const QMetaObject::Connection & connection : m_FrameConnections)
+			{
+				QObject::disconnect(connection);
+			}
+			m_FrameConnections.clear();
+			m_FrameRecorder.reset();
+			m_FrameStatsTimer.stop();
+		}
+
+		UpdateFrameStats();
+		emit frameTimingChanged(value);
+	}
+
+	//!
+	//! Compute the statistics of the frames of the last second.
+	//!
+	QuickView::FrameStats QuickView::GetFrameStats(void) const
+	{
+		FrameStats stats;
+		const std::shared_ptr< FrameRecorder > recorder = m_FrameRecorder;
+		if (recorder == nullptr)
+		{
+			return stats;
+		}
+
+		// the frames of the last second, and their costs
+		const QVector< FrameTimestamps > frames = recorder->GetFrames();
+		const qint64 start = recorder->Now() - s_FrameStatsInterval * 1000;
+		std::vector< double > costs;
+		double sync = 0.0, render = 0.0;
+		int count = 0;
+		for (int i = 0; i < frames.size(); ++i)
+		{
+			const FrameTimestamps & frame = frames[i];
+			if (frame.swapped < start)
+			{
+				continue;
+			}
+			++count;
+			sync += (frame.syncEnd - frame.syncStart) / 1000.0;
+			render += (frame.renderEnd - frame.renderStart) / 1000.0;
+			costs.push_back(frame.GetCost() / 1000.0);
+		}
+
+		auto percentile = [&costs] (double value) {
+			return costs.empty() == true ? 0.0 : costs[std::min(costs.size() - 1, static_cast< size_t >(value * costs.size()))];
+		};
+		std::sort(costs.begin(), costs.end());
+		stats.fps			= count * 1000.0 / s_FrameStatsInterval;
+		stats.frameTimeP50	= percentile(0.5);
+		stats.frameTimeP90	= percentile(0.9);
+		stats.frameTimeP99	= percentile(0.99);
+		stats.frameTimeMax	= costs.empty() == true ? 0.0 : costs.back();
+		stats.syncTime		= count > 0 ? sync / count : 0.0;
+		stats.renderTime	= count > 0 ? render / count : 0.0;
+
+		QMutexLocker lock(&recorder->mutex);
+		stats.frames	= recorder->total;
+		stats.janks		= recorder->janks;
+		return stats;
+	}
+
+	//!
+	//! Write the recorded frames (about the last minute) in the Trace Event format, which
+	//! can be opened in chrome://tracing or https://ui.perfetto.dev
+	//!
+	//! @returns
+	//!		false if frame timing is disabled or the file couldn't be written.
+	//!
+	bool QuickView::DumpFrameTrace(const QString & filename) const
+	{
+		const std::shared_ptr< FrameRecorder > recorder = m_FrameRecorder;
+		if (recorder == nullptr)
+		{
+			return false;
+		}
+
+		QJsonArray events;
+		auto add = [&events] (const char * name, qint64 start, qint64 end, int frame) {
+			if (start > 0 && end >= start)
+			{
+				events.append(QJsonObject{
+					{ "name",	name },
+					{ "ph",		"X" },
+					{ "ts",		static_cast< double >(start) },
+					{ "dur",	static_cast< double >(end - start) },
+					{ "pid",	1 },
+					{ "tid",	1 },
+					{ "args",	QJsonObject{ { "frame", frame } } },
+				});
+			}
+		};
+		const QVector< FrameTimestamps > frames = recorder->GetFrames();
+		for (int i = 0; i < frames.size(); ++i)
+		{
+			const FrameTimestamps & frame = frames[i];
+			add("sync", frame.syncStart, frame.syncEnd, i);
+			add("render", frame.renderStart, frame.renderEnd, i);
+			add("swap", frame.renderEnd, frame.swapped, i);
+			if (frame.GetCost() > recorder->jankThreshold)
+			{
+				add("jank", frame.syncStart, frame.swapped, i);
+			}
+		}
+
+		QFile file(filename);
+		const QByteArray json = QJsonDocument(QJsonObject{ { "traceEvents", events } }).toJson(QJsonDocument::Compact);
+		return file.open(QIODevice::WriteOnly) == true && file.write(json) == json.size();
+	}
+
+	//!
+	//! QML version of DumpFrameTrace.
+	//!
+	bool QuickView::dumpFrameTrace(const QString & filename) const
+	{
+		return DumpFrameTrace(filename);
+	}
+
+	//!
+	//! Update the frameStats property.
+	//!
+	void QuickView::UpdateFrameStats(void)
+	{
+		const FrameStats stats = GetFrameStats();
+		m_FrameStats = {
+			{ "fps",			stats.fps },
+			{ "frameTimeP50",	stats.frameTimeP50 },
+			{ "frameTimeP90",	stats.frameTimeP90 },
+			{ "frameTimeP99",	stats.frameTimeP99 },
+			{ "frameTimeMax",	stats.frameTimeMax },
+			{ "syncTime",		stats.syncTime },
+			{ "renderTime",		stats.renderTime },
+			{ "frames",			static_cast< double >(stats.frames) },
+			{ "janks",			static_cast< double >(stats.janks) },
+		};
+		emit frameStatsChanged(m_FrameStats);
+	}
+
+	//!
+	//! Asynchronously load the QML. Unlike setSource, which compiles and creates the whole root
+	//! component before returning (showing a blank window in the meantime), the component is
+	//! compiled in the background and its objects are created incrementally, a few milliseconds
+	//! per frame, so that the window stays responsive. The window can be shown right away.
+	//! The current content is destroyed once the new one is ready, or restored if the loading
+	//! fails.
+	//!
+	//! @param source
+	//!		The QML to load.
+	//!
+	//! @param placeholder
+	//!		Optional QML loaded synchronously and displayed while @p source loads. It should
+	//!		be minimal (e.g. a background and a busy indicator) since it delays the loading.
+	//!
+	//! @param frameBudget
+	//!		Time spent creating objects on each frame, in milliseconds.
+	//!
+	void QuickView::LoadAsync(const QUrl & source, const QUrl & placeholder, int frameBudget)
+	{
+		// the current content. setContent doesn't destroy the previous root and component (only
+		// setSource does) so we need to keep track of them. If a loading is cancelled, the
+		// current content is still the one it was replacing
+		std::unique_ptr< AsyncLoading > loading(new AsyncLoading);
+		if (m_AsyncLoading != nullptr && m_AsyncLoading->previousRoot != nullptr)
+		{
+			loading->previousSource = m_AsyncLoading->previousSource;
+			loading->previousRoot = m_AsyncLoading->previousRoot;
+			loading->previousComponent = m_AsyncLoading->previousComponent;
+		}
+		else
+		{
+			loading->previousSource = this->source();
+			loading->previousRoot = this->rootObject();
+			for (QQmlComponent * component : this->findChildren< QQmlComponent * >(QString(), Qt::FindDirectChildrenOnly))
+			{
+				if (component->url() == loading->previousSource)
+				{
+					loading->previousComponent = component;
+				}
+			}
+		}
+
+		// cancel the previous loading, if any
+		m_AsyncLoading.reset();
+		m_AsyncLoading = std::move(loading);
+		m_AsyncLoading->source = source;
+		m_AsyncLoading->clock.start();
+		m_LoadingTimes = {
+			{ "firstFrame",	-1 },
+			{ "compiled",	-1 },
+			{ "loaded",		-1 },
+		};
+		emit loadingTimesChanged(m_LoadingTimes);
+		emit loadingChanged(true);
+		SetLoadingProgress(0.0);
+
+		// our incubation controller, to control the time budget
+		const qreal refreshRate = this->screen() != nullptr && this->screen()->refreshRate() > 0.0 ? this->screen()->refreshRate() : 60.0;
+		if (m_IncubationController == nullptr)
+		{
+			m_IncubationController = new QuickViewIncubationController(this);
+		}
+		static_cast< QuickViewIncubationController * >(m_IncubationController)->SetBudget(frameBudget, qRound(1000.0 / refreshRate));
+		this->engine()->setIncubationController(m_IncubationController);
+
+		// the placeholder
+		if (placeholder.isEmpty() == false)
+		{
+			auto component = new QQmlComponent(this->engine(), placeholder, QQmlComponent::PreferSynchronous, this);
+			QQuickItem * item = qobject_cast< QQuickItem * >(component->create(this->rootContext()));
+			m_AsyncLoading->placeholderComponent = component;
+			m_AsyncLoading->placeholder = item;
+			if (item != nullptr)
+			{
+				if (m_AsyncLoading->previousRoot != nullptr)
+				{
+					m_AsyncLoading->previousRoot->setVisible(false);
+				}
+				this->setContent(placeholder, component, item);
+			}
+			else
+			{
+				qWarning() << component->errors();
+			}
+		}
+
+		// time to the first frame
+		m_AsyncLoading->firstFrame = QObject::connect(this, &QQuickWindow::frameSwapped, this, [this] (void) {
+			if (m_AsyncLoading != nullptr)
+			{
+				QObject::disconnect(m_AsyncLoading->firstFrame);
+				m_LoadingTimes["firstFrame"] = static_cast< double >(m_AsyncLoading->clock.elapsed());
+				emit loadingTimesChanged(m_LoadingTimes);
+			}
+		}, Qt::QueuedConnection);
+
+		// start compiling. This can complete synchronously, e.g. if the component is cached
+		auto component = new QQmlComponent(this->engine(), this);
+		m_AsyncLoading->component = component;
+		QObject::connect(component, &QQmlComponent::progressChanged, this, [this] (qreal progress) {
+			SetLoadingProgress(progress * 0.5);
+		});
+		QObject::connect(component, &QQmlComponent::statusChanged, this, &QuickView::OnComponentStatusChanged);
+		component->loadUrl(source, QQmlComponent::Asynchronous);
+		if (component->isLoading() == false)
+		{
+			OnComponentStatusChanged();
+		}
+	}
+
+	//!
+	//! Called when the component of an asynchronous loading is compiled.
+	//!
+	void QuickView::OnComponentStatusChanged(void)
+	{
+		if (m_AsyncLoading == nullptr || m_AsyncLoading->component == nullptr || m_AsyncLoading->incubator != nullptr)
+		{
+			return;
+		}
+
+		QQmlComponent * component = m_AsyncLoading->component;
+		switch (component->status())
+		{
+			case QQmlComponent::Ready:
+				m_LoadingTimes["compiled"] = static_cast< double >(m_AsyncLoading->clock.elapsed());
+				emit loadingTimesChanged(m_LoadingTimes);
+				SetLoadingProgress(0.5);
+
+				// create the objects incrementally. The status can change synchronously
+				m_AsyncLoading->incubator.reset(new QuickViewIncubator([this] (QQmlIncubator::Status status) {
+					OnIncubatorStatusChanged(static_cast< int >(status));
+				}));
+				component->create(*m_AsyncLoading->incubator, this->rootContext());
+				break;
+
+			case QQmlComponent::Error:
+				// setContent reports the errors and updates the status of the view
+				this->setContent(m_AsyncLoading->source, component, nullptr);
+				m_AsyncLoading->installed = true;
+				FinishLoading(nullptr);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	//!
+	//! Called when the status of the incubator of an asynchronous loading changes.
+	//!
+	void QuickView::OnIncubatorStatusChanged(int status)
+	{
+		if (m_AsyncLoading == nullptr || m_AsyncLoading->incubator == nullptr)
+		{
+			return;
+		}
+
+		// the incubator can't be destroyed from its own callback, so the loading is finished later
+		AsyncLoading * loading = m_AsyncLoading.get();
+		QuickViewIncubator & incubator = *loading->incubator;
+		switch (static_cast< QQmlIncubator::Status >(status))
+		{
+			case QQmlIncubator::Ready:
+			{
+				QObject * object = incubator.object();
+				QQuickItem * root = qobject_cast< QQuickItem * >(object);
+				if (root == nullptr)
+				{
+					qWarning("QuickView::LoadAsync: the root object of %s is not an Item", qPrintable(m_AsyncLoading->source.toString()));
+					delete object;
+				}
+				else
+				{
+					this->setContent(m_AsyncLoading->source, m_AsyncLoading->component, root);
+					m_AsyncLoading->installed = true;
+
+					// the previous content would otherwise stay alive (and rendered) under the new root
+					if (m_AsyncLoading->previousRoot != root)
+					{
+						delete m_AsyncLoading->previousRoot.data();
+					}
+					if (m_AsyncLoading->previousComponent != m_AsyncLoading->component && m_AsyncLoading->previousComponent != nullptr)
+					{
+						m_AsyncLoading->previousComponent->deleteLater();
+					}
+				}
+				QMetaObject::invokeMethod(this, [this, loading, root] (void) {
+					if (m_AsyncLoading.get() == loading)
+					{
+						FinishLoading(root);
+					}
+				}, Qt::QueuedConnection);
+				break;
+			}
+
+			case QQmlIncubator::Error:
+				for (const QQmlError & error : incubator.errors())
+				{
+					qWarning() << error;
+				}
+				QMetaObject::invokeMethod(this, [this, loading] (void) {
+					if (m_AsyncLoading.get() == loading)
+					{
+						FinishLoading(nullptr);
+					}
+				}, Qt::QueuedConnection);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	//!
+	//! End the current asynchronous loading.
+	//!
+	void QuickView::FinishLoading(QQuickItem * root)
+	{
+		if (m_AsyncLoading == nullptr)
+		{
+			return;
+		}
+
+		// on failure, restore the previous content, which is hidden while a placeholder is displayed.
+		// Otherwise the placeholder is destroyed with the loading state, so it must not be the root anymore
+		if (root == nullptr && m_AsyncLoading->previousRoot != nullptr)
+		{
+			m_AsyncLoading->previousRoot->setVisible(true);
+			if (this->rootObject() != m_AsyncLoading->previousRoot)
+			{
+				this->setContent(m_AsyncLoading->previousSource, m_AsyncLoading->previousComponent, m_AsyncLoading->previousRoot);
+				m_AsyncLoading->installed = false;
+			}
+		}
+		else if (root == nullptr && m_AsyncLoading->placeholder != nullptr && this->rootObject() == m_AsyncLoading->placeholder)
+		{
+			this->setContent(m_AsyncLoading->source, m_AsyncLoading->component, nullptr);
+			m_AsyncLoading->installed = true;
+		}
+		if (root != nullptr)
+		{
+			m_LoadingTimes["loaded"] = static_cast< double >(m_AsyncLoading->clock.elapsed());
+			emit loadingTimesChanged(m_LoadingTimes);
+		}
+
+		m_AsyncLoading.reset();
+		SetLoadingProgress(1.0);
+		emit loadingChanged(false);
+	}
+
+	//!
+	//! Set the progress of the asynchronous loading. The compilation (including the download
+	//! of remote files) covers the first half, and the creation of the objects the second one.
+	//! Qt doesn't report the progress of the creation, so it's a single step.
+	//!
+	void QuickView::SetLoadingProgress(qreal progress)
+	{
+		if (m_LoadingProgress != progress)
+		{
+			m_LoadingProgress = progress;
+			emit loadingProgressChanged(m_LoadingProgress);
+		}
 	}
 
 	//!
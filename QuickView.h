@@ -7,10 +7,15 @@
 #	pragma warning ( push, 0 )
 #endif
 
+#include <QQmlIncubator>
 #include <QQuickView>
 #include <QStack>
 #include <QTimer>
 #include <QFlag>
+#include <QVariantMap>
+#include <QVector>
+
+#include <memory>
 
 #if (_MSC_VER)
 #	pragma warning ( pop )
@@ -26,6 +31,8 @@ QT_UTILS_NAMESPACE_BEGIN
 	//!		Settings instance has been created.
 	//! - Support dynamic switch to fullscreen using the `fullscreen` property.
 	//! - Makes itself available to QML through the global `rootView` property.
+	//! - Optionally records the timings of the frames, see `frameTiming`.
+	//! - Can load the QML asynchronously, see LoadAsync.
 	//!
 	//! Here is a quick example of how to use it:
 	//!
@@ -64,12 +71,47 @@ QT_UTILS_NAMESPACE_BEGIN
 
 		typedef QFlags< PersistenceFlags > Persistence;
 
+		//!
+		//! Statistics of the recently rendered frames. Durations are in milliseconds.
+		//!
+		//! Qt Quick only renders frames on demand, so the time between 2 frames includes the
+		//! idle periods and says nothing about the rendering performance. Instead, the frame
+		//! time is the cost of each frame: from the start of its synchronization to its swap.
+		//!
+		struct FrameStats
+		{
+			//! Frames per second, over the last second
+			double fps = 0.0;
+
+			//! Percentiles and maximum of the frame times, over the last second
+			double frameTimeP50 = 0.0;
+			double frameTimeP90 = 0.0;
+			double frameTimeP99 = 0.0;
+			double frameTimeMax = 0.0;
+
+			//! Average durations of the synchronization and rendering, over the last second
+			double syncTime = 0.0;
+			double renderTime = 0.0;
+
+			//! Number of frames since the timings were enabled
+			qint64 frames = 0;
+
+			//! Number of janks (frames which took more than 1.5 vertical refresh intervals, and
+			//! so missed at least one) since the timings were enabled
+			qint64 janks = 0;
+		};
+
 	private:
 
 		Q_PROPERTY(bool fullscreen			READ IsFullScreen		WRITE SetFullScreen		NOTIFY fullscreenChanged)
 		Q_PROPERTY(bool maximized			READ IsMaximized		WRITE SetMaximized		NOTIFY maximizedChanged)
 		Q_PROPERTY(bool minimized			READ IsMinimized		WRITE SetMinimized		NOTIFY minimizedChanged)
 		Q_PROPERTY(Persistence persistence	READ GetPersistence		WRITE SetPersistence	NOTIFY persistenceChanged)
+		Q_PROPERTY(bool frameTiming			READ IsFrameTimingEnabled	WRITE SetFrameTimingEnabled	NOTIFY frameTimingChanged)
+		Q_PROPERTY(QVariantMap frameStats	READ GetFrameStatsMap								NOTIFY frameStatsChanged)
+		Q_PROPERTY(bool loading				READ IsLoading											NOTIFY loadingChanged)
+		Q_PROPERTY(qreal loadingProgress	READ GetLoadingProgress									NOTIFY loadingProgressChanged)
+		Q_PROPERTY(QVariantMap loadingTimes	READ GetLoadingTimes									NOTIFY loadingTimesChanged)
 
 	signals:
 
@@ -77,11 +119,17 @@ QT_UTILS_NAMESPACE_BEGIN
 		void maximizedChanged(bool maximized);
 		void minimizedChanged(bool minimized);
 		void persistenceChanged(Persistence persistence);
+		void frameTimingChanged(bool frameTiming);
+		void frameStatsChanged(QVariantMap frameStats);
+		void loadingChanged(bool loading);
+		void loadingProgressChanged(qreal loadingProgress);
+		void loadingTimesChanged(QVariantMap loadingTimes);
 
 	public:
 
-		// constructor
+		// constructor / destructor
 		QuickView(void);
+		~QuickView(void);
 
 		// C++ API
 		inline bool			IsReady(void) const;
@@ -94,6 +142,18 @@ QT_UTILS_NAMESPACE_BEGIN
 		inline Persistence	GetPersistence(void) const;
 		void				SetPersistence(Persistence value);
 		void				Restore(int width, int height, QWindow::Visibility visibility);
+		bool				IsFrameTimingEnabled(void) const;
+		void				SetFrameTimingEnabled(bool value);
+		FrameStats			GetFrameStats(void) const;
+		inline QVariantMap	GetFrameStatsMap(void) const;
+		bool				DumpFrameTrace(const QString & filename) const;
+		void				LoadAsync(const QUrl & source, const QUrl & placeholder = QUrl(), int frameBudget = 8);
+		inline bool			IsLoading(void) const;
+		inline qreal		GetLoadingProgress(void) const;
+		inline QVariantMap	GetLoadingTimes(void) const;
+
+		// QML API
+		Q_INVOKABLE bool	dumpFrameTrace(const QString & filename) const;
 
 	protected:
 
@@ -102,8 +162,19 @@ QT_UTILS_NAMESPACE_BEGIN
 
 	private:
 
+		//! Records the frame timings, only allocated when they're enabled
+		struct FrameRecorder;
+
+		//! State of an asynchronous loading, only allocated while loading
+		struct AsyncLoading;
+
 		// helpers
 		QRect	GetRestoreRect(void) const;
+		void	UpdateFrameStats(void);
+		void	OnComponentStatusChanged(void);
+		void	OnIncubatorStatusChanged(int status);
+		void	FinishLoading(QQuickItem * root);
+		void	SetLoadingProgress(qreal progress);
 
 		//! Persitence flags
 		Persistence m_Persistence;
@@ -123,6 +194,31 @@ QT_UTILS_NAMESPACE_BEGIN
 		//! window flags
 		Qt::WindowFlags m_Flags;
 
+		//! the frame recorder, or nullptr when frame timing is disabled. It's shared with the
+		//! connections to the scene graph signals, which can run on the render thread
+		std::shared_ptr< FrameRecorder > m_FrameRecorder;
+
+		//! the connections to the scene graph signals
+		QVector< QMetaObject::Connection > m_FrameConnections;
+
+		//! periodically updates the frame statistics
+		QTimer m_FrameStatsTimer;
+
+		//! the last frame statistics
+		QVariantMap m_FrameStats;
+
+		//! the current asynchronous loading, or nullptr
+		std::unique_ptr< AsyncLoading > m_AsyncLoading;
+
+		//! progress of the asynchronous loading
+		qreal m_LoadingProgress;
+
+		//! timings of the last asynchronous loading
+		QVariantMap m_LoadingTimes;
+
+		//! incubation controller used by the asynchronous loadings, created by the first one
+		QQmlIncubationController * m_IncubationController;
+
 	};
 
 	//!
@@ -165,6 +261,42 @@ QT_UTILS_NAMESPACE_BEGIN
 		return m_Persistence;
 	}
 
+	//!
+	//! Get the last frame statistics, as an object with the `fps`, `frameTimeP50`, `frameTimeP90`,
+	//! `frameTimeP99`, `frameTimeMax`, `syncTime`, `renderTime`, `frames` and `janks` properties.
+	//! It's updated every second while frame timing is enabled.
+	//!
+	inline QVariantMap QuickView::GetFrameStatsMap(void) const
+	{
+		return m_FrameStats;
+	}
+
+	//!
+	//! Returns true while an asynchronous loading is in progress.
+	//!
+	inline bool QuickView::IsLoading(void) const
+	{
+		return m_AsyncLoading != nullptr;
+	}
+
+	//!
+	//! Get the progress of the asynchronous loading, between 0 and 1.
+	//!
+	inline qreal QuickView::GetLoadingProgress(void) const
+	{
+		return m_LoadingProgress;
+	}
+
+	//!
+	//! Get the timings of the last asynchronous loading, as an object with the `firstFrame`,
+	//! `compiled` and `loaded` properties, in milliseconds since LoadAsync was called (-1
+	//! for the steps which didn't happen yet)
+	//!
+	inline QVariantMap QuickView::GetLoadingTimes(void) const
+	{
+		return m_LoadingTimes;
+	}
+
 	Q_DECLARE_OPERATORS_FOR_FLAGS(QuickView::Persistence)
 
 QT_UTILS_NAMESPACE_END
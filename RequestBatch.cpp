@@ -0,0 +1,322 @@
+#include "./RequestBatch.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QReadWriteLock>
+#include <QUrl>
+#include <QVector>
+
+#include <atomic>
+#include <map>
+
+
+QT_UTILS_NAMESPACE_BEGIN
+
+	//!
+	//! A queued request.
+	//!
+	struct BatchItem
+	{
+		QString url;
+		QString host;
+		SuccessCallback success;
+		FailureCallback failure;
+		RequestOptions options;
+		int priority;
+		quint64 sequence;
+	};
+
+	//!
+	//! The private data of a batch.
+	//!
+	struct RequestBatch::Data
+	{
+		//! Protects the data
+		mutable QMutex mutex;
+
+		//! Limits
+		int maxRequests;
+		int maxRequestsPerHost;
+
+		//! Set when the batch is destroyed
+		std::atomic< bool > destroyed{ false };
+
+		//! Held for reading while a callback runs, and for writing by the destructor, so
+		//! that no callback runs once the batch is destroyed. Recursive since a callback
+		//! can cancel another request
+		QReadWriteLock callbacks{ QReadWriteLock::Recursive };
+
+		//!
+		//! Call @p callback unless the batch is destroyed.
+		//!
+		void Call(const std::function< void (void) > & callback)
+		{
+			QReadLocker lock(&callbacks);
+			if (destroyed == false)
+			{
+				callback();
+			}
+		}
+
+		//! Next request id
+		int nextId = 0;
+
+		//! Sequence counter, used to keep the insertion order for equal priorities
+		quint64 sequence = 0;
+
+		//! Pending requests, by id
+		QHash< int, BatchItem > pending;
+
+		//! Pending requests ids, sorted by descending priority then insertion order
+		std::map< std::pair< int, quint64 >, int > queue;
+
+		//! Number of running requests per host
+		QHash< QString, int > runningPerHost;
+
+		//! Number of running requests
+		int running = 0;
+
+		//! Number of finished requests since the last finished callback
+		int succeeded = 0;
+		int failed = 0;
+
+		//! The finished callback
+		FinishedCallback finished;
+	};
+
+	//!
+	//! Constructor
+	//!
+	//! @param maxRequests
+	//!		Maximum number of requests running at the same time.
+	//!
+	//! @param maxRequestsPerHost
+	//!		Maximum number of requests to the same host running at the same time.
+	//!
+	RequestBatch::RequestBatch(int maxRequests, int maxRequestsPerHost)
+		: m_Data(std::make_shared< Data >())
+	{
+		m_Data->maxRequests			= qMax(1, maxRequests);
+		m_Data->maxRequestsPerHost	= qMax(1, maxRequestsPerHost);
+	}
+
+	//!
+	//! Destructor. Pending requests are dropped, and the callbacks of the running
+	//! ones won't be called. This waits for the callbacks currently running.
+	//!
+	RequestBatch::~RequestBatch(void)
+	{
+		QWriteLocker guard(&m_Data->callbacks);
+		QMutexLocker lock(&m_Data->mutex);
+		m_Data->destroyed = true;
+		m_Data->pending.clear();
+		m_Data->queue.clear();
+	}
+
+	//!
+	//! Set the maximum number of requests running at the same time.
+	//!
+	void RequestBatch::SetMaxRequests(int count)
+	{
+		{
+			QMutexLocker lock(&m_Data->mutex);
+			m_Data->maxRequests = qMax(1, count);
+		}
+		Pump(m_Data);
+	}
+
+	//!
+	//! Set the maximum number of requests to a single host running at the same time.
+	//!
+	void RequestBatch::SetMaxRequestsPerHost(int count)
+	{
+		{
+			QMutexLocker lock(&m_Data->mutex);
+			m_Data->maxRequestsPerHost = qMax(1, count);
+		}
+		Pump(m_Data);
+	}
+
+	//!
+	//! Set the callback called when the batch has finished all its requests.
+	//!
+	void RequestBatch::SetFinishedCallback(const FinishedCallback & callback)
+	{
+		QMutexLocker lock(&m_Data->mutex);
+		m_Data->finished = callback;
+	}
+
+	//!
+	//! Queue a request.
+	//!
+	//! @param url
+	//!		The url to request.
+	//!
+	//! @param success
+	//!		Called when the request successfully completed.
+	//!
+	//! @param failure
+	//!		Called if the request failed or was canceled.
+	//!
+	//! @param priority
+	//!		Priority of the request. Higher priorities are started first.
+	//!
+	//! @param options
+	//!		Options forwarded to RequestUrl.
+	//!
+	//! @returns
+	//!		The id of the request, which can be used to change its priority or cancel it.
+	//!
+	int RequestBatch::Add(const QString & url, const SuccessCallback & success, const FailureCallback & failure, int priority, const RequestOptions & options)
+	{
+		int id = 0;
+		{
+			QMutexLocker lock(&m_Data->mutex);
+			id = m_Data->nextId++;
+			BatchItem item{ url, QUrl(url).host(), success, failure, options, priority, m_Data->sequence++ };
+			m_Data->queue.emplace(std::make_pair(-priority, item.sequence), id);
+			m_Data->pending.insert(id, item);
+		}
+		Pump(m_Data);
+		return id;
+	}
+
+	//!
+	//! Change the priority of a pending request. Returns false if the request is not
+	//! pending anymore (it's already running, finished or was canceled)
+	//!
+	bool RequestBatch::SetPriority(int id, int priority)
+	{
+		QMutexLocker lock(&m_Data->mutex);
+		auto item = m_Data->pending.find(id);
+		if (item == m_Data->pending.end())
+		{
+			return false;
+		}
+		m_Data->queue.erase(std::make_pair(-item->priority, item->sequence));
+		item->priority = priority;
+		m_Data->queue.emplace(std::make_pair(-item->priority, item->sequence), id);
+		return true;
+	}
+
+	//!
+	//! Cancel a pending request. Its failure callback is called with an
+	//! OperationCanceledError, from the calling thread. Returns false if the request
+	//! was not pending.
+	//!
+	bool RequestBatch::Cancel(int id)
+	{
+		BatchItem item;
+		{
+			QMutexLocker lock(&m_Data->mutex);
+			auto found = m_Data->pending.find(id);
+			if (found == m_Data->pending.end())
+			{
+				return false;
+			}
+			item = found.value();
+			m_Data->queue.erase(std::make_pair(-item.priority, item.sequence));
+			m_Data->pending.erase(found);
+		}
+		item.failure(QNetworkReply::OperationCanceledError, "Operation canceled");
+		return true;
+	}
+
+	//!
+	//! Cancel all the pending requests. Their failure callbacks are not called.
+	//!
+	void RequestBatch::CancelAll(void)
+	{
+		QMutexLocker lock(&m_Data->mutex);
+		m_Data->pending.clear();
+		m_Data->queue.clear();
+	}
+
+	//!
+	//! Get the number of requests waiting to be started.
+	//!
+	int RequestBatch::GetPendingCount(void) const
+	{
+		QMutexLocker lock(&m_Data->mutex);
+		return m_Data->pending.size();
+	}
+
+	//!
+	//! Get the number of requests currently running.
+	//!
+	int RequestBatch::GetRunningCount(void) const
+	{
+		QMutexLocker lock(&m_Data->mutex);
+		return m_Data->running;
+	}
+
+	//!
+	//! Start as many pending requests as the limits allow, highest priorities first.
+	//!
+	void RequestBatch::Pump(const std::shared_ptr< Data > & data)
+	{
+		// select the requests to start
+		QVector< BatchItem > start;
+		{
+			QMutexLocker lock(&data->mutex);
+			for (auto it = data->queue.begin(); it != data->queue.end() && data->running < data->maxRequests;)
+			{
+				int & hostRunning = data->runningPerHost[data->pending[it->second].host];
+				if (hostRunning >= data->maxRequestsPerHost)
+				{
+					++it;
+					continue;
+				}
+				++hostRunning;
+				++data->running;
+				start.push_back(data->pending.take(it->second));
+				it = data->queue.erase(it);
+			}
+		}
+
+		// and start them outside the lock, since callbacks can be called synchronously
+		for (const BatchItem & item : start)
+		{
+			auto done = [data, host = item.host] (bool success) {
+				FinishedCallback finished;
+				int succeeded = 0, failed = 0;
+				{
+					QMutexLocker lock(&data->mutex);
+					--data->running;
+					if (--data->runningPerHost[host] == 0)
+					{
+						data->runningPerHost.remove(host);
+					}
+					++(success == true ? data->succeeded : data->failed);
+					if (data->running == 0 && data->pending.isEmpty() == true && data->destroyed == false)
+					{
+						finished = data->finished;
+						succeeded = data->succeeded;
+						failed = data->failed;
+						data->succeeded = data->failed = 0;
+					}
+				}
+				Pump(data);
+				if (finished)
+				{
+					data->Call([&] (void) { finished(succeeded, failed); });
+				}
+			};
+
+			RequestUrl(
+				item.url,
+				[data, done, success = item.success] (QByteArray reply) {
+					data->Call([&] (void) { success(reply); });
+					done(true);
+				},
+				[data, done, failure = item.failure] (QNetworkReply::NetworkError error, QString errorString) {
+					data->Call([&] (void) { failure(error, errorString); });
+					done(false);
+				},
+				item.options
+			);
+		}
+	}
+
+QT_UTILS_NAMESPACE_END
@@ -0,0 +1,80 @@
+#ifndef QT_UTILS_REQUEST_BATCH_H
+#define QT_UTILS_REQUEST_BATCH_H
+
+#include "./HttpRequest.h"
+
+#include <memory>
+
+
+QT_UTILS_NAMESPACE_BEGIN
+
+	//!
+	//! Download queue on top of RequestUrl. Instead of sending all the requests at
+	//! once and letting Qt queue them without any priority, the batch only runs a
+	//! limited number of requests at a time (globally and per host) and always
+	//! starts the pending request with the highest priority first. Priorities can
+	//! be changed while a request is queued, e.g. to promote a thumbnail that just
+	//! became visible:
+	//!
+	//! ```.cpp
+	//! RequestBatch batch(8, 4);
+	//! batch.SetFinishedCallback([] (int succeeded, int failed) { ... });
+	//! for (const QString & url : urls)
+	//! {
+	//! 	ids[url] = batch.Add(url, success, failure);
+	//! }
+	//!
+	//! // later, when an item becomes visible
+	//! batch.SetPriority(ids[visibleUrl], 100);
+	//! ```
+	//!
+	//! All callbacks are called from the network threads, except the failure callback of
+	//! a request canceled with Cancel, which is called from the calling thread. When the
+	//! batch is destroyed, the pending requests are dropped and no more callbacks are called:
+	//! the destructor waits for the callbacks currently running, so the batch must not be
+	//! destroyed from one of its callbacks.
+	//!
+	class RequestBatch
+	{
+
+	public:
+
+		//!
+		//! Signature of the callback called each time the batch has no more pending
+		//! nor running request, with the number of requests that succeeded and failed
+		//! since the previous call.
+		//!
+		typedef std::function< void (int succeeded, int failed) > FinishedCallback;
+
+		// constructor / destructor
+		RequestBatch(int maxRequests = 6, int maxRequestsPerHost = 2);
+		~RequestBatch(void);
+
+		// C++ API
+		void	SetMaxRequests(int count);
+		void	SetMaxRequestsPerHost(int count);
+		void	SetFinishedCallback(const FinishedCallback & callback);
+		int		Add(const QString & url, const SuccessCallback & success, const FailureCallback & failure, int priority = 0, const RequestOptions & options = RequestOptions());
+		bool	SetPriority(int id, int priority);
+		bool	Cancel(int id);
+		void	CancelAll(void);
+		int		GetPendingCount(void) const;
+		int		GetRunningCount(void) const;
+
+	private:
+
+		//! Private data, shared with the running requests
+		struct Data;
+
+		// private API
+		static void Pump(const std::shared_ptr< Data > & data);
+
+		//! The data
+		std::shared_ptr< Data > m_Data;
+
+	};
+
+QT_UTILS_NAMESPACE_END
+
+
+#endif
@@ -0,0 +1,613 @@
+#include "./Utf8.h"
+
+#include <QtAlgorithms>
+
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#	include <immintrin.h>
+#	if defined(_MSC_VER)
+#		include <intrin.h>
+#		define QT_UTILS_TARGET_AVX2
+#	else
+#		define QT_UTILS_TARGET_AVX2 __attribute__((target("avx2")))
+#	endif
+#	define QT_UTILS_UTF8_AVX2
+#	if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#		define QT_UTILS_UTF8_SSE2
+#	endif
+#endif
+
+
+QT_UTILS_NAMESPACE_BEGIN
+
+	//!
+	//! Number of UTF-16 code units encoded at once. The output buffer is sized for the worst
+	//! case of each chunk, so this bounds the over-allocation.
+	//!
+	static const qint64 s_EncodeChunkSize = 1024 * 1024;
+
+	//!
+	//! Vectorized parts of the conversions. They process the leading ASCII characters of
+	//! their input, and return how many they processed.
+	//!
+	//! The decoding ones can write up to a full register past the returned count, but
+	//! never past @p size: since UTF-8 never needs less bytes than UTF-16 code units, the
+	//! output of a decoding always fits in a buffer of the size of the input.
+	//!
+	struct Kernels
+	{
+		//! Get the number of leading ASCII bytes
+		qint64 (* asciiLength)(const uchar * data, qint64 size);
+
+		//! Widen the leading ASCII bytes to UTF-16
+		qint64 (* decodeAscii)(const uchar * source, ushort * destination, qint64 size);
+
+		//! Narrow the leading ASCII UTF-16 code units to bytes
+		qint64 (* encodeAscii)(const ushort * source, uchar * destination, qint64 size);
+	};
+
+	//!
+	//! Scalar version of Kernels::asciiLength, 8 bytes at a time.
+	//!
+	static qint64 AsciiLengthScalar(const uchar * data, qint64 size)
+	{
+		qint64 i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			quint64 block;
+			memcpy(&block, data + i, sizeof(block));
+			if ((block & 0x8080808080808080ULL) != 0)
+			{
+				break;
+			}
+		}
+		while (i < size && data[i] < 0x80)
+		{
+			++i;
+		}
+		return i;
+	}
+
+	//!
+	//! Scalar version of Kernels::decodeAscii.
+	//!
+	static qint64 DecodeAsciiScalar(const uchar * source, ushort * destination, qint64 size)
+	{
+		qint64 i = 0;
+		for (; i < size && source[i] < 0x80; ++i)
+		{
+			destination[i] = source[i];
+		}
+		return i;
+	}
+
+	//!
+	//! Scalar version of Kernels::encodeAscii.
+	//!
+	static qint64 EncodeAsciiScalar(const ushort * source, uchar * destination, qint64 size)
+	{
+		qint64 i = 0;
+		for (; i < size && source[i] < 0x80; ++i)
+		{
+			destination[i] = static_cast< uchar >(source[i]);
+		}
+		return i;
+	}
+
+#if defined(QT_UTILS_UTF8_SSE2)
+
+	//!
+	//! SSE2 version of Kernels::asciiLength, 16 bytes at a time.
+	//!
+	static qint64 AsciiLengthSSE2(const uchar * data, qint64 size)
+	{
+		qint64 i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			const int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast< const __m128i * >(data + i)));
+			if (mask != 0)
+			{
+				return i + qCountTrailingZeroBits(static_cast< quint32 >(mask));
+			}
+		}
+		return i + AsciiLengthScalar(data + i, size - i);
+	}
+
+	//!
+	//! SSE2 version of Kernels::decodeAscii.
+	//!
+	static qint64 DecodeAsciiSSE2(const uchar * source, ushort * destination, qint64 size)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		qint64 i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast< const __m128i * >(source + i));
+			_mm_storeu_si128(reinterpret_cast< __m128i * >(destination + i), _mm_unpacklo_epi8(bytes, zero));
+			_mm_storeu_si128(reinterpret_cast< __m128i * >(destination + i + 8), _mm_unpackhi_epi8(bytes, zero));
+			const int mask = _mm_movemask_epi8(bytes);
+			if (mask != 0)
+			{
+				return i + qCountTrailingZeroBits(static_cast< quint32 >(mask));
+			}
+		}
+		return i + DecodeAsciiScalar(source + i, destination + i, size - i);
+	}
+
+	//!
+	//! SSE2 version of Kernels::encodeAscii.
+	//!
+	static qint64 EncodeAsciiSSE2(const ushort * source, uchar * destination, qint64 size)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i nonAscii = _mm_set1_epi16(static_cast< short >(0xFF80));
+		qint64 i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			const __m128i low = _mm_loadu_si128(reinterpret_cast< const __m128i * >(source + i));
+			const __m128i high = _mm_loadu_si128(reinterpret_cast< const __m128i * >(source + i + 8));
+			const __m128i bits = _mm_and_si128(_mm_or_si128(low, high), nonAscii);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(bits, zero)) != 0xFFFF)
+			{
+				break;
+			}
+			_mm_storeu_si128(reinterpret_cast< __m128i * >(destination + i), _mm_packus_epi16(low, high));
+		}
+		return i + EncodeAsciiScalar(source + i, destination + i, size - i);
+	}
+
+#endif
+
+#if defined(QT_UTILS_UTF8_AVX2)
+
+	//!
+	//! AVX2 version of Kernels::asciiLength, 32 bytes at a time.
+	//!
+	QT_UTILS_TARGET_AVX2 static qint64 AsciiLengthAVX2(const uchar * data, qint64 size)
+	{
+		qint64 i = 0;
+		for (; i + 32 <= size; i += 32)
+		{
+			const int mask = _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast< const __m256i * >(data + i)));
+			if (mask != 0)
+			{
+				return i + qCountTrailingZeroBits(static_cast< quint32 >(mask));
+			}
+		}
+		return i + AsciiLengthScalar(data + i, size - i);
+	}
+
+	//!
+	//! AVX2 version of Kernels::decodeAscii.
+	//!
+	QT_UTILS_TARGET_AVX2 static qint64 DecodeAsciiAVX2(const uchar * source, ushort * destination, qint64 size)
+	{
+		qint64 i = 0;
+		for (; i + 32 <= size; i += 32)
+		{
+			const __m256i bytes = _mm256_loadu_si256(reinterpret_cast< const __m256i * >(source + i));
+			_mm256_storeu_si256(reinterpret_cast< __m256i * >(destination + i), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)));
+			_mm256_storeu_si256(reinterpret_cast< __m256i * >(destination + i + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)));
+			const int mask = _mm256_movemask_epi8(bytes);
+			if (mask != 0)
+			{
+				return i + qCountTrailingZeroBits(static_cast< quint32 >(mask));
+			}
+		}
+		return i + DecodeAsciiScalar(source + i, destination + i, size - i);
+	}
+
+	//!
+	//! AVX2 version of Kernels::encodeAscii.
+	//!
+	QT_UTILS_TARGET_AVX2 static qint64 EncodeAsciiAVX2(const ushort * source, uchar * destination, qint64 size)
+	{
+		const __m256i nonAscii = _mm256_set1_epi16(static_cast< short >(0xFF80));
+		qint64 i = 0;
+		for (; i + 32 <= size; i += 32)
+		{
+			const __m256i low = _mm256_loadu_si256(reinterpret_cast< const __m256i * >(source + i));
+			const __m256i high = _mm256_loadu_si256(reinterpret_cast< const __m256i * >(source + i + 16));
+			if (_mm256_testz_si256(_mm256_or_si256(low, high), nonAscii) == 0)
+			{
+				break;
+			}
+
+			// packing works on each 128 bits lane, so the 64 bits blocks need to be reordered
+			const __m256i packed = _mm256_packus_epi16(low, high);
+			_mm256_storeu_si256(reinterpret_cast< __m256i * >(destination + i), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+		}
+		return i + EncodeAsciiScalar(source + i, destination + i, size - i);
+	}
+
+	//!
+	//! Check if the CPU and the OS support AVX2.
+	//!
+	static bool HasAVX2(void)
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		// AVX and OSXSAVE, and the OS saves the YMM registers
+		__cpuid(info, 1);
+		if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+
+#endif
+
+	//!
+	//! The kernels of each implementation. Unsupported ones fall back to the scalar version.
+	//!
+	static const Kernels s_Kernels[] = {
+		{ AsciiLengthScalar, DecodeAsciiScalar, EncodeAsciiScalar },
+#if defined(QT_UTILS_UTF8_SSE2)
+		{ AsciiLengthSSE2, DecodeAsciiSSE2, EncodeAsciiSSE2 },
+#else
+		{ AsciiLengthScalar, DecodeAsciiScalar, EncodeAsciiScalar },
+#endif
+#if defined(QT_UTILS_UTF8_AVX2)
+		{ AsciiLengthAVX2, DecodeAsciiAVX2, EncodeAsciiAVX2 },
+#else
+		{ AsciiLengthScalar, DecodeAsciiScalar, EncodeAsciiScalar },
+#endif
+	};
+
+	//!
+	//! Get the current implementation, initialized with the best supported one.
+	//!
+	static std::atomic< int > & GetCurrent(void)
+	{
+		static std::atomic< int > current{ static_cast< int >(
+			IsUtf8ImplementationSupported(Utf8Implementation::AVX2) == true ? Utf8Implementation::AVX2 :
+			IsUtf8ImplementationSupported(Utf8Implementation::SSE2) == true ? Utf8Implementation::SSE2 :
+			Utf8Implementation::Scalar
+		) };
+		return current;
+	}
+
+	//!
+	//! Get the kernels of the current implementation.
+	//!
+	static inline const Kernels & GetKernels(void)
+	{
+		return s_Kernels[GetCurrent().load(std::memory_order_relaxed)];
+	}
+
+	//!
+	//! Decode a sequence starting with a non ASCII byte.
+	//!
+	//! @returns
+	//!		The length of the sequence, or if it's invalid, minus the length of its invalid
+	//!		part (the maximal subpart defined by Unicode, which is replaced by a single U+FFFD)
+	//!
+	static inline int DecodeSequence(const uchar * source, const uchar * end, uint & codePoint)
+	{
+		// the range of the second byte excludes overlong forms, surrogates and code points
+		// above U+10FFFF
+		const uchar lead = *source;
+		uchar low = 0x80, high = 0xBF;
+		int length;
+		if (lead >= 0xC2 && lead <= 0xDF)
+		{
+			length = 2;
+			codePoint = lead & 0x1F;
+		}
+		else if (lead >= 0xE0 && lead <= 0xEF)
+		{
+			length = 3;
+			codePoint = lead & 0x0F;
+			low = lead == 0xE0 ? 0xA0 : 0x80;
+			high = lead == 0xED ? 0x9F : 0xBF;
+		}
+		else if (lead >= 0xF0 && lead <= 0xF4)
+		{
+			length = 4;
+			codePoint = lead & 0x07;
+			low = lead == 0xF0 ? 0x90 : 0x80;
+			high = lead == 0xF4 ? 0x8F : 0xBF;
+		}
+		else
+		{
+			return -1;
+		}
+
+		for (int i = 1; i < length; ++i)
+		{
+			if (source + i == end || source[i] < low || source[i] > high)
+			{
+				return -i;
+			}
+			codePoint = (codePoint << 6) | (source[i] & 0x3F);
+			low = 0x80;
+			high = 0xBF;
+		}
+		return length;
+	}
+
+	//!
+	//! Record the first error.
+	//!
+	static inline void SetError(qint64 * errorOffset, qint64 offset)
+	{
+		if (errorOffset != nullptr && *errorOffset == -1)
+		{
+			*errorOffset = offset;
+		}
+	}
+
+	//!
+	//! Check that @p data is valid UTF-8.
+	//!
+	bool IsValidUtf8(const char * data, qint64 size, qint64 * errorOffset)
+	{
+		if (errorOffset != nullptr)
+		{
+			*errorOffset = -1;
+		}
+
+		const Kernels & kernels = GetKernels();
+		const uchar * begin = reinterpret_cast< const uchar * >(data);
+		const uchar * source = begin;
+		const uchar * end = begin + qMax(qint64(0), size);
+		while (source < end)
+		{
+			source += kernels.asciiLength(source, end - source);
+			while (source < end && *source >= 0x80)
+			{
+				uint codePoint;
+				const int length = DecodeSequence(source, end, codePoint);
+				if (length < 0)
+				{
+					SetError(errorOffset, source - begin);
+					return false;
+				}
+				source += length;
+			}
+		}
+		return true;
+	}
+
+	//!
+	//! Decode UTF-8 data. Inputs bigger than 2GB can't be held in a QString, and return a
+	//! null string.
+	//!
+	QString DecodeUtf8(const char * data, qint64 size, Utf8Mode mode, qint64 * errorOffset)
+	{
+		if (errorOffset != nullptr)
+		{
+			*errorOffset = -1;
+		}
+		if (size <= 0)
+		{
+			return data != nullptr ? QString(QLatin1String("")) : QString();
+		}
+		if (size > std::numeric_limits< int >::max())
+		{
+			return QString();
+		}
+
+		// each byte gives at most one UTF-16 code unit
+		QString result(static_cast< int >(size), Qt::Uninitialized);
+		ushort * output = reinterpret_cast< ushort * >(result.data());
+		ushort * destination = output;
+
+		const Kernels & kernels = GetKernels();
+		const uchar * begin = reinterpret_cast< const uchar * >(data);
+		const uchar * source = begin;
+		const uchar * end = begin + size;
+		while (source < end)
+		{
+			const qint64 ascii = kernels.decodeAscii(source, destination, end - source);
+			source += ascii;
+			destination += ascii;
+
+			while (source < end && *source >= 0x80)
+			{
+				uint codePoint;
+				const int length = DecodeSequence(source, end, codePoint);
+				if (length < 0)
+				{
+					SetError(errorOffset, source - begin);
+					if (mode == Utf8Mode::Strict)
+					{
+						return QString();
+					}
+					*destination++ = QChar::ReplacementCharacter;
+					source -= length;
+				}
+				else
+				{
+					if (QChar::requiresSurrogates(codePoint) == true)
+					{
+						*destination++ = QChar::highSurrogate(codePoint);
+						*destination++ = QChar::lowSurrogate(codePoint);
+					}
+					else
+					{
+						*destination++ = static_cast< ushort >(codePoint);
+					}
+					source += length;
+				}
+			}
+		}
+
+		result.resize(static_cast< int >(destination - output));
+		return result;
+	}
+
+	//!
+	//! Decode UTF-8 data.
+	//!
+	QString DecodeUtf8(const QByteArray & data, Utf8Mode mode, qint64 * errorOffset)
+	{
+		return DecodeUtf8(data.constData(), data.size(), mode, errorOffset);
+	}
+
+	//!
+	//! Encode UTF-16 data to UTF-8. Unpaired surrogates are invalid. The output is built by
+	//! chunks, so that its worst case size is never allocated at once.
+	//!
+	QByteArray EncodeUtf8(const QChar * data, int size, Utf8Mode mode, qint64 * errorOffset)
+	{
+		if (errorOffset != nullptr)
+		{
+			*errorOffset = -1;
+		}
+		if (size <= 0)
+		{
+			return data != nullptr ? QByteArray("") : QByteArray();
+		}
+
+		QByteArray result;
+		const Kernels & kernels = GetKernels();
+		const ushort * begin = reinterpret_cast< const ushort * >(data);
+		const ushort * source = begin;
+		const ushort * end = begin + size;
+		while (source < end)
+		{
+			// don't split surrogate pairs
+			const ushort * chunkEnd = source + qMin(qint64(end - source), s_EncodeChunkSize);
+			if (chunkEnd < end && QChar::isHighSurrogate(chunkEnd[-1]) == true)
+			{
+				--chunkEnd;
+			}
+
+			// each UTF-16 code unit gives at most 3 bytes
+			const qint64 used = result.size();
+			const qint64 capacity = used + (chunkEnd - source) * 3;
+			if (capacity > std::numeric_limits< int >::max())
+			{
+				return QByteArray();
+			}
+			result.resize(static_cast< int >(capacity));
+			uchar * output = reinterpret_cast< uchar * >(result.data()) + used;
+			uchar * destination = output;
+
+			while (source < chunkEnd)
+			{
+				const qint64 ascii = kernels.encodeAscii(source, destination, chunkEnd - source);
+				source += ascii;
+				destination += ascii;
+
+				while (source < chunkEnd && *source >= 0x80)
+				{
+					uint codePoint = *source++;
+					if (QChar::isSurrogate(codePoint) == true)
+					{
+						if (QChar::isHighSurrogate(codePoint) == true && source < chunkEnd && QChar::isLowSurrogate(*source) == true)
+						{
+							codePoint = QChar::surrogateToUcs4(static_cast< ushort >(codePoint), *source++);
+						}
+						else
+						{
+							SetError(errorOffset, source - 1 - begin);
+							if (mode == Utf8Mode::Strict)
+							{
+								return QByteArray();
+							}
+							codePoint = QChar::ReplacementCharacter;
+						}
+					}
+
+					if (codePoint < 0x800)
+					{
+						*destination++ = static_cast< uchar >(0xC0 | (codePoint >> 6));
+					}
+					else if (codePoint < 0x10000)
+					{
+						*destination++ = static_cast< uchar >(0xE0 | (codePoint >> 12));
+						*destination++ = static_cast< uchar >(0x80 | ((codePoint >> 6) & 0x3F));
+					}
+					else
+					{
+						*destination++ = static_cast< uchar >(0xF0 | (codePoint >> 18));
+						*destination++ = static_cast< uchar >(0x80 | ((codePoint >> 12) & 0x3F));
+						*destination++ = static_cast< uchar >(0x80 | ((codePoint >> 6) & 0x3F));
+					}
+					*destination++ = static_cast< uchar >(0x80 | (codePoint & 0x3F));
+				}
+			}
+
+			result.resize(static_cast< int >(used + (destination - output)));
+		}
+		return result;
+	}
+
+	//!
+	//! Encode a string to UTF-8.
+	//!
+	QByteArray EncodeUtf8(const QString & string, Utf8Mode mode, qint64 * errorOffset)
+	{
+		return EncodeUtf8(string.constData(), string.size(), mode, errorOffset);
+	}
+
+	//!
+	//! Get the implementation currently used.
+	//!
+	Utf8Implementation GetUtf8Implementation(void)
+	{
+		return static_cast< Utf8Implementation >(GetCurrent().load());
+	}
+
+	//!
+	//! Force an implementation. Returns false if it's not supported by this CPU or build.
+	//!
+	bool SetUtf8Implementation(Utf8Implementation implementation)
+	{
+		if (IsUtf8ImplementationSupported(implementation) == false)
+		{
+			return false;
+		}
+		GetCurrent() = static_cast< int >(implementation);
+		return true;
+	}
+
+	//!
+	//! Check if an implementation is supported by this CPU and build.
+	//!
+	bool IsUtf8ImplementationSupported(Utf8Implementation implementation)
+	{
+		switch (implementation)
+		{
+			case Utf8Implementation::Scalar:
+				return true;
+
+			case Utf8Implementation::SSE2:
+#if defined(QT_UTILS_UTF8_SSE2)
+				return true;
+#else
+				return false;
+#endif
+
+			case Utf8Implementation::AVX2:
+#if defined(QT_UTILS_UTF8_AVX2)
+			{
+				static const bool supported = HasAVX2();
+				return supported;
+			}
+#else
+				return false;
+#endif
+		}
+		return false;
+	}
+
+QT_UTILS_NAMESPACE_END
@@ -0,0 +1,68 @@
+#ifndef QT_UTILS_UTF8_H
+#define QT_UTILS_UTF8_H
+
+#include "./Setup.h"
+
+#include <QByteArray>
+#include <QString>
+
+
+QT_UTILS_NAMESPACE_BEGIN
+
+	//!
+	//! How invalid UTF-8 (or unpaired surrogates when encoding) is handled.
+	//!
+	enum class Utf8Mode
+	{
+		//! Each invalid sequence is replaced by U+FFFD, like QString::fromUtf8 does
+		Replace,
+
+		//! The conversion fails, and the offset of the first invalid sequence is reported
+		Strict
+	};
+
+	//!
+	//! Implementations of the conversions. The best one supported by the CPU is selected at
+	//! runtime, but it can be forced (e.g. to benchmark them)
+	//!
+	enum class Utf8Implementation
+	{
+		Scalar,
+		SSE2,
+		AVX2
+	};
+
+	//!
+	//! UTF-8 validation and conversions. Pure ASCII runs, which are most of the content of
+	//! usual text files, are checked and converted 16 (SSE2) or 32 (AVX2) bytes at a time,
+	//! the other characters being handled by a scalar path. Invalid input is never silently
+	//! dropped: it's either replaced by U+FFFD or reported, depending on the mode:
+	//!
+	//! ```.cpp
+	//! qint64 error = -1;
+	//! const QString text = DecodeUtf8(data, Utf8Mode::Strict, &error);
+	//! if (error != -1)
+	//! {
+	//! 	qWarning("Invalid UTF-8 at offset %lld", error);
+	//! }
+	//! ```
+	//!
+	//! In strict mode, a failed conversion returns a null string or array. @p errorOffset,
+	//! when given, is set to the offset (in bytes when decoding, in UTF-16 code units when
+	//! encoding) of the first invalid sequence, or -1 if there was none.
+	//!
+	bool		IsValidUtf8(const char * data, qint64 size, qint64 * errorOffset = nullptr);
+	QString		DecodeUtf8(const char * data, qint64 size, Utf8Mode mode = Utf8Mode::Replace, qint64 * errorOffset = nullptr);
+	QString		DecodeUtf8(const QByteArray & data, Utf8Mode mode = Utf8Mode::Replace, qint64 * errorOffset = nullptr);
+	QByteArray	EncodeUtf8(const QChar * data, int size, Utf8Mode mode = Utf8Mode::Replace, qint64 * errorOffset = nullptr);
+	QByteArray	EncodeUtf8(const QString & string, Utf8Mode mode = Utf8Mode::Replace, qint64 * errorOffset = nullptr);
+
+	// implementation selection
+	Utf8Implementation	GetUtf8Implementation(void);
+	bool				SetUtf8Implementation(Utf8Implementation implementation);
+	bool				IsUtf8ImplementationSupported(Utf8Implementation implementation);
+
+QT_UTILS_NAMESPACE_END
+
+
+#endif